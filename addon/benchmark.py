@@ -0,0 +1,76 @@
+"""
+Headless benchmark of CMF exporter, it is run by Blender without interface:
+
+    blender --background --factory-startup --python addon/benchmark.py -- [scene.blend] [--levels N] [--save scene.blend] [--output out.cmf]
+
+Scene is opened from given .blend file, otherwise test scene is built: ico sphere of
+N subdivisions (10 by default, 5M triangles) with UVs, every second face is flat.
+Built scene may be saved with --save and passed later, so runs use the same data.
+"""
+
+import bpy
+import os
+import sys
+import time
+
+sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+import cmf_export
+
+def parseArguments():
+    argv = sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else []
+    args = { "scene": None, "levels": 10, "save": None, "output": os.path.join(bpy.app.tempdir or "/tmp", "benchmark.cmf") }
+
+    i = 0
+    while i < len(argv):
+        if argv[i] == "--levels": args["levels"] = int(argv[i + 1]); i += 1
+        elif argv[i] == "--save": args["save"] = argv[i + 1]; i += 1
+        elif argv[i] == "--output": args["output"] = argv[i + 1]; i += 1
+        else: args["scene"] = argv[i]
+        i += 1
+
+    return args
+
+def buildScene(levels):
+    import numpy as np
+
+    for ob in list(bpy.context.scene.objects):
+        bpy.data.objects.remove(ob, do_unlink=True)
+
+    bpy.ops.mesh.primitive_ico_sphere_add(subdivisions=levels, calc_uvs=True)
+    me = bpy.context.active_object.data
+
+    smooth = np.arange(len(me.polygons)) % 2 == 0
+    me.polygons.foreach_set("use_smooth", smooth)
+    me.update()
+
+def measure(name, **kwargs):
+    begin = time.perf_counter()
+    cmf_export.writeFile(**kwargs)
+    seconds = time.perf_counter() - begin
+
+    print("%-24s %8.3f s %12d bytes" % (name, seconds, os.path.getsize(kwargs["filepath"])))
+
+def main():
+    args = parseArguments()
+
+    if args["scene"] is not None:
+        bpy.ops.wm.open_mainfile(filepath=args["scene"])
+    else:
+        buildScene(args["levels"])
+
+    if args["save"] is not None:
+        bpy.ops.wm.save_as_mainfile(filepath=args["save"])
+
+    triangles = 0
+    for ob in bpy.context.scene.objects:
+        if ob.type == 'MESH':
+            ob.data.calc_loop_triangles()
+            triangles += len(ob.data.loop_triangles)
+
+    print("Triangles: %d" % triangles)
+
+    measure("Vertices", filepath=args["output"])
+    measure("Indexed vertices", filepath=args["output"], write_indexes=True)
+    measure("Indexed, all arrays", filepath=args["output"], write_indexes=True, write_tangents=True, write_colors=True)
+
+main()
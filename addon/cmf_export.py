@@ -1,8 +1,8 @@
 import bpy
 import bmesh
 import struct
+import numpy as np
 from enum import IntEnum
-from itertools import groupby
 
 class Compression(IntEnum):
     No   = 1 << 0
@@ -37,26 +37,155 @@ def sizeFromFormat(f):
 
     return 0
 
+def dtypeFromFormat(f):
+    if f == Format.Byte: return np.int8
+    if f == Format.UByte: return np.uint8
+    if f == Format.Short: return np.int16
+    if f == Format.UShort: return np.uint16
+    if f == Format.Int: return np.int32
+    if f == Format.UInt: return np.uint32
+    if f == Format.Half: return np.float16
+    if f == Format.Float: return np.float32
+    if f == Format.Double: return np.float64
+
+# Smallest format which holds every index of given count of vertices, the same as util uses
+def indexFormat(num_vertices):
+    if num_vertices <= 0x100: return Format.UByte
+    if num_vertices <= 0x10000: return Format.UShort
+    return Format.UInt
+
+# Whole array is converted into little-endian buffer and written at once
 def writeArray(file, array_type, array_format, array):
-    element_size = sizeFromFormat(array_format)
-    element_pack = ""
-
-    if array_format == Format.Byte: element_pack = "b"
-    elif array_format == Format.UByte: element_pack = "B"
-    elif array_format == Format.Short: element_pack = "h"
-    elif array_format == Format.UShort: element_pack = "H"
-    elif array_format == Format.Int: element_pack = "i"
-    elif array_format == Format.UInt: element_pack = "I"
-    #elif array_format = Format.Half:
-    elif array_format == Format.Float: element_pack = "f"
-    elif array_format == Format.Double: element_pack = "d"
-
-    file.write(struct.pack("I", array_type))
-    file.write(struct.pack("I", array_format))
-    file.write(struct.pack("I", len(array) * element_size))
-
-    for elem in array:
-        file.write(struct.pack(element_pack, elem))
+    data = np.ascontiguousarray(array, dtype=np.dtype(dtypeFromFormat(array_format)).newbyteorder("<"))
+
+    file.write(struct.pack("<III", array_type, array_format, data.nbytes))
+    file.write(memoryview(data).cast("B"))
+
+# Reads attribute of every element of collection into flat float32 array without Python objects
+def getAttribute(collection, attribute, components, dtype=np.float32):
+    data = np.empty(len(collection) * components, dtype=dtype)
+    collection.foreach_get(attribute, data)
+    return data.reshape(-1, components)
+
+# Normals of corners, flat faces get face normal and smooth ones get vertex normal, as split normals do
+def getCornerNormals(me):
+    if hasattr(me, "corner_normals"):
+        return getAttribute(me.corner_normals, "vector", 3)
+
+    me.calc_normals_split()
+    return getAttribute(me.loops, "normal", 3)
+
+def getCornerTangents(me):
+    if me.uv_layers.active is None:
+        return np.zeros((len(me.loops), 4), dtype=np.float32)
+
+    me.calc_tangents()
+    tangents = np.empty((len(me.loops), 4), dtype=np.float32)
+    tangents[:, 0:3] = getAttribute(me.loops, "tangent", 3)
+    tangents[:, 3] = getAttribute(me.loops, "bitangent_sign", 1)[:, 0]
+    me.free_tangents()
+    return tangents
+
+# Colors of corners of active color attribute, colors of points are given to their corners
+def getCornerColors(me, vertex_indices):
+    if hasattr(me, "color_attributes"):
+        layer = me.color_attributes.active_color
+
+        if layer is not None:
+            colors = getAttribute(layer.data, "color", 4)
+            return colors[vertex_indices] if layer.domain == 'POINT' else colors
+    elif me.vertex_colors.active is not None:
+        return getAttribute(me.vertex_colors.active.data, "color", 4)
+
+    return np.zeros((len(me.loops), 4), dtype=np.float32)
+
+"""
+Collects attributes of corners of triangles of mesh as columns of one float32 table.
+Mesh is triangulated through loop triangles, so objects of scene are not modified.
+"""
+def getCorners(me, columns):
+    me.calc_loop_triangles()
+
+    loops = getAttribute(me.loop_triangles, "loops", 3, np.int32).ravel()
+    vertex_indices = getAttribute(me.loops, "vertex_index", 1, np.int32).ravel()
+
+    sources = {
+        Type.Positions: lambda: getAttribute(me.vertices, "co", 3)[vertex_indices],
+        Type.Texcoords: lambda: getAttribute(me.uv_layers.active.data, "uv", 2) if me.uv_layers.active is not None else np.zeros((len(me.loops), 2), dtype=np.float32),
+        Type.Normals:   lambda: getCornerNormals(me),
+        Type.Tangents:  lambda: getCornerTangents(me),
+        Type.Colors:    lambda: getCornerColors(me, vertex_indices),
+    }
+
+    return np.hstack([sources[array_type]()[loops] for array_type, _ in columns])
+
+"""
+calc_tangents fails on faces with more than four corners, so corners of mesh with n-gons
+are collected from its triangulated copy when tangents are written. Mesh itself is not modified.
+"""
+def getMeshCorners(me, columns):
+    needs_tangents = any(array_type == Type.Tangents for array_type, _ in columns)
+
+    if not needs_tangents or me.uv_layers.active is None or not (getAttribute(me.polygons, "loop_total", 1, np.int32) > 4).any():
+        return getCorners(me, columns)
+
+    copy = me.copy()
+    bm = bmesh.new()
+    bm.from_mesh(copy)
+    bmesh.ops.triangulate(bm, faces=bm.faces[:])
+    bm.to_mesh(copy)
+    bm.free()
+
+    try:
+        return getCorners(copy, columns)
+    finally:
+        bpy.data.meshes.remove(copy)
+
+# 64-bit FNV-1a of 32-bit words of every row
+def hashRows(corners):
+    words = corners.view(np.uint32)
+    hashes = np.full(len(words), 0xCBF29CE484222325, dtype=np.uint64)
+
+    for column in words.T:
+        hashes ^= column
+        hashes *= np.uint64(0x100000001B3)
+
+    return hashes ^ (hashes >> np.uint64(29))
+
+# Groups equal keys, returns first index of every group and group of every key
+def uniqueKeys(keys):
+    order = np.argsort(keys)
+    sorted_keys = keys[order]
+
+    starts = np.flatnonzero(np.concatenate(([True], sorted_keys[1:] != sorted_keys[:-1])))
+    groups = np.empty(len(keys), dtype=np.int64)
+    groups[order] = np.cumsum(np.concatenate(([False], sorted_keys[1:] != sorted_keys[:-1])))
+
+    # Sort is not stable, so the first use of group is the smallest index in it
+    return np.minimum.reduceat(order, starts), groups
+
+"""
+Welds bitwise identical vertices by sorting 64-bit hashes of rows, which is much faster
+than sorting rows themselves. Result is checked, rows are sorted only if hashes collide.
+Unique vertices are kept in order of their first use, so indices stay cache friendly.
+"""
+def weldVertices(corners):
+    if len(corners) == 0:
+        return corners, np.zeros(0, dtype=np.uint32)
+
+    corners = np.ascontiguousarray(corners)
+    first, inverse = uniqueKeys(hashRows(corners))
+
+    if not np.array_equal(corners[first[inverse]].view(np.uint32), corners.view(np.uint32)):
+        rows = corners.view(np.dtype((np.void, corners.dtype.itemsize * corners.shape[1]))).ravel()
+        _, first, inverse = np.unique(rows, return_index=True, return_inverse=True)
+        inverse = inverse.ravel()
+
+    order = np.argsort(first)
+    remap = np.empty_like(order)
+    remap[order] = np.arange(len(order))
+
+    return corners[first[order]], remap[inverse].astype(np.uint32)
 
 def writeFile(filepath="",
               select_only=False,
@@ -69,115 +198,47 @@ def writeFile(filepath="",
 
     magic = b"COLUMBUS MODEL FORMAT  \0"
     version = 1
-    filesize = 48
     flags = 0
     compression = Compression.No
-    num_vertices = 0
-    num_arrays = 0
-
-    verts = []
-    uvs = []
-    norms = []
-    tangs = []
-    cols = []
-    inds = []
-    indices_format = Format.UByte
-
-    objects = bpy.context.scene.objects
-
-    if select_only:
-        objects = bpy.context.active_object
-
-    for ob in objects:
-        try:
-            ob.data.polygons
-        except AttributeError:
-            continue
-
-        me = ob.data
-        bm = bmesh.new()
-        bm.from_mesh(me)
-        bmesh.ops.triangulate(bm, faces=bm.faces[:])
-        bm.to_mesh(me)
-        bm.free()
-
-        if write_indexes:
-            vert_hash = {}
-
-            for face in me.polygons:
-                for vert, loop in zip(face.vertices, face.loop_indices):
-                    v = me.vertices[vert].co
-                    u = me.uv_layers.active.data[loop].uv if me.uv_layers.active != None else (0, 0)
-                    n = me.vertices[vert].normal if face.use_smooth else face.normal.xyz
-                    c = me.vertex_colors.active.data[loop].color if me.vertex_colors.active != None else (0, 0, 0)
-                    new_vert = (tuple(v), tuple(u), tuple(n), tuple(c))
-
-                    if new_vert in vert_hash:
-                        inds.append(vert_hash[new_vert])
-                    else:
-                        vert_hash[new_vert] = num_vertices
-                        inds.append(num_vertices)
-                        num_vertices += 1
-
-                        verts.extend(v)
-                        uvs.extend(u)
-                        norms.extend(n)
-                        cols.extend(c)
-
-            if len(inds) > 255:
-                indices_format = Format.UShort
-
-            if len(inds) > 65535:
-                indices_format = Format.UInt
-        else:
-            for face in me.polygons:
-                for vert, loop in zip(face.vertices, face.loop_indices):
-                    num_vertices += 1
-
-                    verts.extend(me.vertices[vert].co)
-                    uvs.extend(me.uv_layers.active.data[loop].uv if me.uv_layers.active != None else (0, 0))
-                    norms.extend(me.vertices[vert].normal if face.use_smooth else face.normal.xyz)
-                    cols.extend(me.vertex_colors.active.data[loop].color if me.vertex_colors.active != None else (0, 0, 0))
-
-    if write_positions:
-        num_arrays += 1
-        filesize += len(verts) * 4
-    if write_texcoords:
-        num_arrays += 1
-        filesize += len(uvs) * 4
-    if write_normals:
-        num_arrays += 1
-        filesize += len(norms) * 4
-    if write_tangents:
-        num_arrays += 1
-        filesize += len(tangs) * 4
-    if write_colors:
-        num_arrays += 1
-        filesize += len(cols) * 4
+
+    # Written arrays and count of their components, in order of file
+    columns = [(Type.Positions, 3)]
+    if write_texcoords: columns.append((Type.Texcoords, 2))
+    if write_normals:   columns.append((Type.Normals, 3))
+    if write_tangents:  columns.append((Type.Tangents, 4))
+    if write_colors:    columns.append((Type.Colors, 4))
+
+    objects = bpy.context.selected_objects if select_only else bpy.context.scene.objects
+    tables = [getMeshCorners(ob.data, columns) for ob in objects if ob.type == 'MESH']
+
+    width = sum(components for _, components in columns)
+    corners = np.vstack(tables) if tables else np.zeros((0, width), dtype=np.float32)
+    inds = None
+
     if write_indexes:
-        num_arrays += 1
-        filesize += len(inds) * sizeFromFormat(indices_format)
+        corners, inds = weldVertices(corners)
 
-    array_header_size = 12
-    filesize += num_arrays * array_header_size
+    num_vertices = len(corners)
+    indices_format = indexFormat(num_vertices)
+
+    arrays = []
+    offset = 0
 
-    file = open(filepath, "wb")
+    for array_type, components in columns:
+        if array_type != Type.Positions or write_positions:
+            arrays.append((array_type, Format.Float, corners[:, offset:offset + components]))
 
-    file.write(magic)
-    file.write(struct.pack("I", version))
-    file.write(struct.pack("I", filesize))
-    file.write(struct.pack("I", flags))
-    file.write(struct.pack("I", compression))
-    file.write(struct.pack("I", num_vertices))
-    file.write(struct.pack("I", num_arrays))
+        offset += components
 
-    if write_positions: writeArray(file, Type.Positions, Format.Float,    verts)
-    if write_texcoords: writeArray(file, Type.Texcoords, Format.Float,    uvs)
-    if write_normals:   writeArray(file, Type.Normals,   Format.Float,    norms)
-    if write_tangents:  writeArray(file, Type.Tangents,  Format.Float,    tangs)
-    if write_colors:    writeArray(file, Type.Colors,    Format.Float,    cols)
-    if write_indexes:   writeArray(file, Type.Indices,   indices_format,  inds)
+    if write_indexes:
+        arrays.append((Type.Indices, indices_format, inds))
 
-    file.close()
+    array_header_size = 12
+    filesize = 48 + sum(array_header_size + array.size * sizeFromFormat(array_format) for _, array_format, array in arrays)
 
+    with open(filepath, "wb") as file:
+        file.write(magic)
+        file.write(struct.pack("<IIIIII", version, filesize, flags, compression, num_vertices, len(arrays)))
 
+        for array_type, array_format, array in arrays:
+            writeArray(file, array_type, array_format, array)
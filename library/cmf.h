@@ -4,7 +4,48 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include <zstd.h>
+#include <atomic>
+#include <new>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+	#include <windows.h>
+	#include <io.h>
+	#include <sys/stat.h>
+#else
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+#if defined(CMF_IO_URING) && defined(__linux__)
+	#include <linux/io_uring.h>
+	#include <sys/syscall.h>
+#endif
+
+#ifdef CMF_ENABLE_STATS
+	#include <chrono>
+	#include <unordered_map>
+#endif
+
+#if defined(__AVX2__) || defined(__F16C__)
+	#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+	#define CMF_SIMD_WIDTH 32
+	#define CMF_SIMD_MOVE(dst, src) _mm256_storeu_si256((__m256i*)(dst), _mm256_loadu_si256((const __m256i*)(src)))
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define CMF_SIMD_WIDTH 16
+	#define CMF_SIMD_MOVE(dst, src) _mm_storeu_si128((__m128i*)(dst), _mm_loadu_si128((const __m128i*)(src)))
+#endif
 
 /**
 * @file cmf.h
@@ -29,113 +70,3733 @@ struct CMF_ArrayHeader
 	uint32_t size;
 };
 
+/*
+* Table of contents follows header when CMF_FLAG_TOC is set, it is CMF_Toc and capacity of entries,
+* entries after header.num_arrays are unused. Arrays still have their headers, so they may be read one by one.
+*/
+struct CMF_Toc
+{
+	uint32_t capacity;
+	uint32_t reserved;
+};
+
+struct CMF_TocEntry
+{
+	uint32_t type;
+	uint32_t format;
+	uint64_t offset;      ///< Offset of array data in file, it follows CMF_ArrayHeader
+	uint32_t size;        ///< Size of loaded array, uncompressed size of compressed one
+	uint32_t stored_size; ///< Size of array data in file, equal to size of CMF_ArrayHeader
+};
+
+/*
+* Pack holds many CMF files: CMF_PackHeader, entries sorted by hash of name, (1 << bucket_bits) + 1
+* indices of first entry of every bucket of high bits of hash, names with terminating zeros
+* and files at offsets aligned by CMF_PACK_ALIGNMENT, so mapped pack is read without copying.
+*/
+struct CMF_PackHeader
+{
+	uint8_t  magic[24];
+	uint32_t version;
+	uint32_t num_entries;
+	uint32_t bucket_bits;
+	uint32_t reserved;
+	uint64_t names_offset;
+	uint64_t names_size;
+};
+
+struct CMF_PackEntry
+{
+	uint64_t hash;        ///< CMF_HashName of name
+	uint64_t offset;      ///< Offset of file in pack
+	uint64_t size;        ///< Size of file
+	uint32_t name_offset; ///< Offset of name in names
+	uint32_t name_size;   ///< Length of name without terminating zero
+};
+
 #define CMF_MAGIC_STRING "COLUMBUS MODEL FORMAT  \0"
+#define CMF_PACK_MAGIC_STRING "COLUMBUS MODEL PACK    \0"
+#define CMF_PACK_ALIGNMENT 64
+
+enum CMF_Compression
+{
+	CMF_COMPRESSION_NONE = 1 << 0,
+	CMF_COMPRESSION_ZSTD = 1 << 1
+};
+
+enum CMF_Type
+{
+	CMF_TYPE_POSITION          = 0,
+	CMF_TYPE_TEXCOORD          = 1,
+	CMF_TYPE_NORMAL            = 2,
+	CMF_TYPE_TANGENT           = 3,
+	CMF_TYPE_COLOR             = 4,
+	CMF_TYPE_INDICES           = 5,
+	CMF_TYPE_BOUNDS            = 6, ///< 6 floats of min and max corners of box, on which normalized positions are mapped
+	CMF_TYPE_MESHLETS          = 7, ///< CMF_Meshlet descriptors, format is UINT
+	CMF_TYPE_MESHLET_VERTICES  = 8, ///< UINT indices of vertices used by meshlets
+	CMF_TYPE_MESHLET_TRIANGLES = 9, ///< UBYTE triples of indices into vertices of meshlet
+	CMF_TYPE_LOD_ERRORS        = 10, ///< FLOAT error of every level of detail, starting from level 0
+	CMF_TYPE_MESHLET_BOUNDS    = 11 ///< CMF_MeshletBounds of every meshlet, format is FLOAT
+};
+
+/*
+* Arrays of levels of detail have level in high bits of type, level 0 is plain type.
+* Levels share vertex arrays and differ by CMF_TYPE_LOD(CMF_TYPE_INDICES, level) arrays.
+*/
+#define CMF_TYPE_LOD(type, level) ((uint32_t)(type) | ((uint32_t)(level) << 16))
+#define CMF_TYPE_BASE(type)       ((uint32_t)(type) & 0xFFFF)
+#define CMF_TYPE_LEVEL(type)      ((uint32_t)(type) >> 16)
+
+/*
+* Bit of type in mask of loaded types, levels of detail share bit of their type.
+*/
+#define CMF_TYPE_BIT(type) (1u << (CMF_TYPE_BASE(type) & 31))
+#define CMF_ALL_TYPES      0xFFFFFFFFu
+
+enum CMF_Flags
+{
+	CMF_FLAG_LODS = 1 << 0, ///< File has arrays of several levels of detail
+	CMF_FLAG_TOC  = 1 << 1  ///< Header is followed by table of contents
+};
+
+enum CMF_Format
+{
+	CMF_FORMAT_BYTE   = 0,
+	CMF_FORMAT_UBYTE  = 1,
+	CMF_FORMAT_SHORT  = 2,
+	CMF_FORMAT_USHORT = 3,
+	CMF_FORMAT_INT    = 4,
+	CMF_FORMAT_UINT   = 5,
+	CMF_FORMAT_HALF   = 6,
+	CMF_FORMAT_FLOAT  = 7,
+	CMF_FORMAT_DOUBLE = 8
+};
+
+struct CMF_InfoArray
+{
+	uint32_t type;
+	uint32_t format;
+	uint32_t size;
+	void* data;
+};
+
+struct CMF_Info
+{
+	uint32_t compression;
+	uint32_t num_vertices;
+	uint32_t num_arrays;
+
+	struct CMF_InfoArray* arrays;
+};
+
+#ifdef CMF_ENABLE_STATS
+
+enum CMF_StatsOperation
+{
+	CMF_STATS_LOAD = 0,
+	CMF_STATS_SAVE = 1
+};
+
+/*!
+* @brief Stored and loaded size of one array of loaded or saved file.
+*/
+struct CMF_ArrayStats
+{
+	uint32_t type;
+	uint32_t format;
+	uint64_t stored_size; ///< Size of array data in file, compressed size of compressed array.
+	uint64_t size;        ///< Size of array in memory, before dequantization.
+};
+
+/*!
+* @brief Statistics of one load or save, which are passed to CMF_StatsCallback.
+*
+* Times are wall times of phases on calling thread, phases which run on several threads are measured as a whole.
+* Allocations are the ones of arrays and of temporary buffers of library, ZSTD contexts are not counted.
+*/
+struct CMF_Stats
+{
+	uint32_t operation;        ///< CMF_STATS_LOAD or CMF_STATS_SAVE.
+	const char* filename;      ///< Name of file or of file in pack, NULL for CMF_ReaderRead.
+	int result;                ///< Result of operation, 0 if it was successful.
+	uint64_t bytes_read;       ///< Bytes read from file, mapped or buffered bytes which were parsed.
+	uint64_t bytes_written;    ///< Bytes written into file.
+	double open_seconds;       ///< Opening of file and reading or writing of headers.
+	double io_seconds;         ///< Reading of arrays or writing of them.
+	double zstd_seconds;       ///< Decompression of arrays or compression of them.
+	double repack_seconds;     ///< Copying of arrays into arena or out of buffer and dequantization.
+	uint64_t num_allocations;  ///< Count of allocations.
+	uint64_t peak_bytes;       ///< Maximum of memory allocated at once.
+	uint32_t num_arrays;       ///< Count of arrays which were loaded or saved.
+	const struct CMF_ArrayStats* arrays; ///< Arrays, valid only during callback.
+};
+
+/*!
+* @brief Called after every load or save, on the thread which did it, so it may be called from several threads at once.
+*/
+typedef void (*CMF_StatsCallback)(const struct CMF_Stats* stats, void* user);
+
+static CMF_StatsCallback CMF_stats_callback = NULL;
+static void* CMF_stats_user = NULL;
+
+/*!
+* @brief Sets function which receives statistics of loads and saves, NULL disables them.
+*
+* Statistics are available only if CMF_ENABLE_STATS is defined before cmf.h is included,
+* otherwise every CMF_STATS macro is empty. Statistics are reported by CMF_Load2Ex, CMF_LoadFromPackEx,
+* every request of CMF_LoadAsync, CMF_OpenReader, CMF_ReaderRead and CMF_Save2Ex.
+* Callback must be set before loads and saves are started.
+*/
+void CMF_SetStatsCallback(CMF_StatsCallback callback, void* user)
+{
+	CMF_stats_callback = callback;
+	CMF_stats_user = user;
+}
+
+/*
+* Statistics of operation which is running on this thread, nested operations are counted by the outer one.
+*/
+struct CMF_StatsScope
+{
+	struct CMF_Stats stats;
+	std::vector<struct CMF_ArrayStats> arrays;
+	std::unordered_map<const void*, size_t> allocations;
+	uint64_t allocated;
+	int active;
+
+	CMF_StatsScope(uint32_t operation, const char* filename);
+	~CMF_StatsScope();
+};
+
+static thread_local struct CMF_StatsScope* CMF_stats_scope = NULL;
+
+CMF_StatsScope::CMF_StatsScope(uint32_t operation, const char* filename)
+{
+	memset(&stats, 0, sizeof(stats));
+	stats.operation = operation;
+	stats.filename = filename;
+	stats.result = -1;
+	allocated = 0;
+	active = CMF_stats_callback != NULL && CMF_stats_scope == NULL;
+
+	if (active) CMF_stats_scope = this;
+}
+
+CMF_StatsScope::~CMF_StatsScope()
+{
+	if (!active) return;
+
+	CMF_stats_scope = NULL;
+	stats.num_arrays = (uint32_t)arrays.size();
+	stats.arrays = arrays.data();
+	CMF_stats_callback(&stats, CMF_stats_user);
+}
+
+static double CMF_StatsNow()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void CMF_StatsAlloc(const void* pointer, size_t size)
+{
+	struct CMF_StatsScope* scope = CMF_stats_scope;
+	if (scope == NULL || pointer == NULL) return;
+
+	scope->allocations[pointer] = size;
+	scope->allocated += size;
+	scope->stats.num_allocations++;
+	if (scope->allocated > scope->stats.peak_bytes) scope->stats.peak_bytes = scope->allocated;
+}
+
+static void CMF_StatsFree(const void* pointer)
+{
+	struct CMF_StatsScope* scope = CMF_stats_scope;
+	if (scope == NULL) return;
+
+	auto it = scope->allocations.find(pointer);
+	if (it == scope->allocations.end()) return;
+
+	scope->allocated -= it->second;
+	scope->allocations.erase(it);
+}
+
+static void CMF_StatsArray(uint32_t type, uint32_t format, uint64_t stored_size, uint64_t size)
+{
+	if (CMF_stats_scope != NULL) CMF_stats_scope->arrays.push_back({ type, format, stored_size, size });
+}
+
+	#define CMF_STATS_SCOPE(operation, filename) struct CMF_StatsScope cmf_stats_scope(operation, filename)
+	#define CMF_STATS_RESULT(value) (cmf_stats_scope.stats.result = (value))
+	#define CMF_STATS_ADD(field, value) do { if (CMF_stats_scope != NULL) CMF_stats_scope->stats.field += (value); } while (0)
+	#define CMF_STATS_TIMER(name) double name = CMF_stats_scope != NULL ? CMF_StatsNow() : 0.0
+	#define CMF_STATS_TIME(field, timer) CMF_STATS_ADD(field, CMF_StatsNow() - (timer))
+	#define CMF_STATS_ALLOC(pointer, size) CMF_StatsAlloc(pointer, size)
+	#define CMF_STATS_FREE(pointer) CMF_StatsFree(pointer)
+	#define CMF_STATS_ARRAY(type, format, stored_size, size) CMF_StatsArray(type, format, stored_size, size)
+#else
+	#define CMF_STATS_SCOPE(operation, filename)
+	#define CMF_STATS_RESULT(value) (value)
+	#define CMF_STATS_ADD(field, value) ((void)0)
+	#define CMF_STATS_TIMER(name)
+	#define CMF_STATS_TIME(field, timer) ((void)0)
+	#define CMF_STATS_ALLOC(pointer, size) ((void)0)
+	#define CMF_STATS_FREE(pointer) ((void)0)
+	#define CMF_STATS_ARRAY(type, format, stored_size, size) ((void)0)
+#endif
+
+#define CMF_ARRAY_ALIGNMENT 64
+
+/*!
+* @brief Allocator of loaded arrays, functions may be called from several threads at once.
+*/
+struct CMF_Allocator
+{
+	void* (*alloc)(void* user, size_t size, size_t alignment); ///< Returns memory aligned by power of two alignment or NULL.
+	void  (*free)(void* user, void* pointer);                  ///< Releases memory returned by alloc.
+	void* user;
+};
+
+static void* CMF_ArenaAlloc(void* user, size_t size, size_t alignment);
+
+static void* CMF_Alloc(const struct CMF_Allocator* allocator, size_t size)
+{
+	void* pointer = allocator != NULL ? allocator->alloc(allocator->user, size, CMF_ARRAY_ALIGNMENT) : malloc(size);
+
+	// Arrays placed into arena are counted by allocation of the whole block
+	if (allocator == NULL || allocator->alloc != CMF_ArenaAlloc) CMF_STATS_ALLOC(pointer, size);
+
+	return pointer;
+}
+
+static void CMF_Free(const struct CMF_Allocator* allocator, void* pointer)
+{
+	if (pointer == NULL) return;
+	CMF_STATS_FREE(pointer);
+
+	if (allocator != NULL) allocator->free(allocator->user, pointer);
+	else free(pointer);
+}
+
+/*
+* Bump allocator over one block, its memory is released only with the whole block.
+*/
+struct CMF_Arena
+{
+	uint8_t* base;
+	size_t size;
+	size_t used;
+};
+
+static void* CMF_ArenaAlloc(void* user, size_t size, size_t alignment)
+{
+	struct CMF_Arena* arena = (struct CMF_Arena*)user;
+
+	size_t offset = ((uintptr_t)(arena->base + arena->used) + alignment - 1) / alignment * alignment - (uintptr_t)arena->base;
+	if (offset > arena->size || size > arena->size - offset) return NULL;
+
+	arena->used = offset + size;
+	return arena->base + offset;
+}
+
+static void CMF_ArenaFree(void* user, void* pointer)
+{
+	(void)user;
+	(void)pointer;
+}
+
+#define CMF_MESHLET_MAX_VERTICES 64
+#define CMF_MESHLET_MAX_TRIANGLES 124
+
+/*!
+* @brief Cluster of triangles, element of CMF_TYPE_MESHLETS array.
+*/
+struct CMF_Meshlet
+{
+	uint32_t vertex_offset;   ///< First element of meshlet in CMF_TYPE_MESHLET_VERTICES array.
+	uint32_t triangle_offset; ///< First byte of meshlet in CMF_TYPE_MESHLET_TRIANGLES array.
+	uint32_t vertex_count;    ///< Count of vertices, at most CMF_MESHLET_MAX_VERTICES.
+	uint32_t triangle_count;  ///< Count of triangles, at most CMF_MESHLET_MAX_TRIANGLES.
+};
+
+/*!
+* @brief Bounds of meshlet for culling, element of CMF_TYPE_MESHLET_BOUNDS array,
+* which has the same order as CMF_TYPE_MESHLETS array.
+*/
+struct CMF_MeshletBounds
+{
+	float center[3];    ///< Center of bounding sphere.
+	float radius;       ///< Radius of bounding sphere.
+	float cone_axis[3]; ///< Average direction of triangle normals.
+	float cone_cutoff;  ///< Sine of normal cone angle, 1 if triangles face too different directions.
+};
+
+/*!
+* @brief Checks if every triangle of meshlet faces away from camera, so meshlet may be culled.
+*
+* @param bounds Bounds of meshlet from CMF_TYPE_MESHLET_BOUNDS array.
+* @param camera Position of camera in space of model.
+* @return Returns 1 if meshlet is backfacing, otherwise returns 0.
+*/
+int CMF_IsMeshletBackfacing(const struct CMF_MeshletBounds* bounds, const float* camera)
+{
+	float direction[3] =
+	{
+		bounds->center[0] - camera[0],
+		bounds->center[1] - camera[1],
+		bounds->center[2] - camera[2]
+	};
+
+	float distance = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+	float projection = direction[0] * bounds->cone_axis[0] + direction[1] * bounds->cone_axis[1] + direction[2] * bounds->cone_axis[2];
+
+	return projection >= bounds->cone_cutoff * distance + bounds->radius;
+}
+
+/*!
+* @brief Finds array of given type.
+*
+* @param info Loaded info.
+* @param type Type of array, CMF_TYPE_LOD may be used to find array of level.
+* @return First array of the type or NULL if info has no such array.
+*/
+struct CMF_InfoArray* CMF_FindArray(const struct CMF_Info* info, uint32_t type)
+{
+	for (uint32_t array = 0; array < info->num_arrays; array++)
+	{
+		if (info->arrays[array].type == type) return &info->arrays[array];
+	}
+
+	return NULL;
+}
+
+/*!
+* @brief Selects the coarsest level of detail which error is not visible on screen.
+*
+* Error of level is a distance in units of positions, it is projected onto screen as (error * projection_scale / distance).
+* For perspective projection projection_scale is (viewport height / (2 * tan(fov / 2))).
+*
+* @param errors Data of CMF_TYPE_LOD_ERRORS array.
+* @param num_levels Count of levels in errors.
+* @param distance Distance from camera to model.
+* @param projection_scale Scale of projection onto screen in pixels.
+* @param max_pixels Maximal visible error in pixels.
+* @return Level of detail, 0 is the most detailed level.
+*/
+uint32_t CMF_SelectLod(const float* errors, uint32_t num_levels, float distance, float projection_scale, float max_pixels)
+{
+	uint32_t level = 0;
+
+	while (level + 1 < num_levels && errors[level + 1] * projection_scale <= max_pixels * distance) level++;
+
+	return level;
+}
+
+#define CMF_DEFAULT_COMPRESSION_LEVEL 3
+#define CMF_DEFAULT_BLOCK_SIZE (1 << 20)
+#define CMF_MAX_DICTIONARIES 16
+
+static uint32_t CMF_NumThreads(uint32_t num_threads)
+{
+	if (num_threads == 0) num_threads = std::thread::hardware_concurrency();
+	return num_threads == 0 ? 1 : num_threads;
+}
+
+/*!
+* @brief Caller-owned ZSTD state, which is reused between loads and saves.
+*
+* Context keeps ZSTD contexts of every thread and dictionaries of array types,
+* so their tables are not rebuilt for every file. One context must not be used by several calls at the same time.
+*/
+struct CMF_Context
+{
+	uint32_t num_threads;
+	ZSTD_CCtx** cctxs;
+	ZSTD_DCtx** dctxs;
+	ZSTD_CDict* cdicts[CMF_MAX_DICTIONARIES];
+	ZSTD_DDict* ddicts[CMF_MAX_DICTIONARIES];
+};
+
+/*!
+* @brief Frees context created with CMF_CreateContext.
+*/
+void CMF_FreeContext(struct CMF_Context* context)
+{
+	if (context == NULL) return;
+
+	for (uint32_t thread = 0; thread < context->num_threads; thread++)
+	{
+		if (context->cctxs != NULL) ZSTD_freeCCtx(context->cctxs[thread]);
+		if (context->dctxs != NULL) ZSTD_freeDCtx(context->dctxs[thread]);
+	}
+
+	for (uint32_t type = 0; type < CMF_MAX_DICTIONARIES; type++)
+	{
+		ZSTD_freeCDict(context->cdicts[type]);
+		ZSTD_freeDDict(context->ddicts[type]);
+	}
+
+	free(context->cctxs);
+	free(context->dctxs);
+	free(context);
+}
+
+/*!
+* @brief Creates context for loads and saves.
+*
+* @param num_threads Maximal count of threads which work with the context, 0 for all hardware threads.
+* @return Created context or NULL if error was occured.
+*/
+struct CMF_Context* CMF_CreateContext(uint32_t num_threads)
+{
+	struct CMF_Context* context = (struct CMF_Context*)calloc(1, sizeof(struct CMF_Context));
+	if (context == NULL) return NULL;
+
+	context->num_threads = CMF_NumThreads(num_threads);
+	context->cctxs = (ZSTD_CCtx**)calloc(context->num_threads, sizeof(ZSTD_CCtx*));
+	context->dctxs = (ZSTD_DCtx**)calloc(context->num_threads, sizeof(ZSTD_DCtx*));
+
+	if (context->cctxs == NULL || context->dctxs == NULL) { CMF_FreeContext(context); return NULL; }
+
+	return context;
+}
+
+/*!
+* @brief Sets trained ZSTD dictionary for arrays of given type.
+*
+* ID of dictionary is written into header of every frame compressed with it,
+* loading picks dictionary of the context by this ID.
+*
+* @param context Context, -1 is returned if it is NULL.
+* @param type Type of arrays which would be compressed with the dictionary.
+* @param dict Dictionary data, it is copied.
+* @param size Size of dictionary data.
+* @param level Compression level, it is bound to the dictionary.
+* @return Returns 0 if dictionary was set, otherwise returns -1.
+*/
+int CMF_ContextSetDictionary(struct CMF_Context* context, uint32_t type, const void* dict, size_t size, int level)
+{
+	if (context == NULL || type >= CMF_MAX_DICTIONARIES) return -1;
+
+	ZSTD_CDict* cdict = ZSTD_createCDict(dict, size, level);
+	ZSTD_DDict* ddict = ZSTD_createDDict(dict, size);
+
+	if (cdict == NULL || ddict == NULL)
+	{
+		ZSTD_freeCDict(cdict);
+		ZSTD_freeDDict(ddict);
+		return -1;
+	}
+
+	ZSTD_freeCDict(context->cdicts[type]);
+	ZSTD_freeDDict(context->ddicts[type]);
+	context->cdicts[type] = cdict;
+	context->ddicts[type] = ddict;
+
+	return 0;
+}
+
+static const ZSTD_DDict* CMF_FindDictionary(const struct CMF_Context* context, unsigned id)
+{
+	if (context == NULL || id == 0) return NULL;
+
+	for (uint32_t type = 0; type < CMF_MAX_DICTIONARIES; type++)
+	{
+		if (context->ddicts[type] != NULL && ZSTD_getDictID_fromDDict(context->ddicts[type]) == id) return context->ddicts[type];
+	}
+
+	return NULL;
+}
+
+/*!
+* @brief Returns size of one component of format in bytes or 0 if format is unknown.
+*/
+uint32_t CMF_FormatSize(uint32_t format)
+{
+	switch (format)
+	{
+	case CMF_FORMAT_BYTE:   case CMF_FORMAT_UBYTE:                        return 1;
+	case CMF_FORMAT_SHORT:  case CMF_FORMAT_USHORT: case CMF_FORMAT_HALF: return 2;
+	case CMF_FORMAT_INT:    case CMF_FORMAT_UINT:   case CMF_FORMAT_FLOAT: return 4;
+	case CMF_FORMAT_DOUBLE:                                               return 8;
+	}
+
+	return 0;
+}
+
+static uint32_t CMF_ArrayComponents(const struct CMF_InfoArray* array, uint32_t num_vertices)
+{
+	uint64_t element = (uint64_t)num_vertices * CMF_FormatSize(array->format);
+	if (element == 0 || array->size % element != 0) return 0;
+	return (uint32_t)(array->size / element);
+}
+
+static int CMF_IsOctahedral(uint32_t type, uint32_t components)
+{
+	return (type == CMF_TYPE_NORMAL || type == CMF_TYPE_TANGENT) && components == 2;
+}
+
+/*!
+* @brief Returns count of floats in every vertex of array converted by CMF_DequantizeArray or 0 if array is invalid.
+*/
+uint32_t CMF_DequantizedComponents(const struct CMF_InfoArray* array, uint32_t num_vertices)
+{
+	uint32_t components = CMF_ArrayComponents(array, num_vertices);
+	return CMF_IsOctahedral(array->type, components) ? 3 : components;
+}
+
+static float CMF_HalfToFloat(uint16_t half)
+{
+	uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1F;
+	uint32_t mantissa = half & 0x3FF;
+	uint32_t bits;
+
+	if (exponent == 0x1F)
+	{
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else if (exponent != 0)
+	{
+		bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	}
+	else
+	{
+		// Subnormal half is a normal float
+		float value = mantissa * (1.0f / 16777216.0f);
+		memcpy(&bits, &value, sizeof(bits));
+		bits |= sign;
+	}
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+/*
+* Reads component as float, normalized formats are returned as integers,
+* snorm ones are clamped to symmetric range.
+*/
+static inline float CMF_LoadComponent(const void* src, uint32_t format, uint64_t index)
+{
+	switch (format)
+	{
+	case CMF_FORMAT_BYTE:   { int8_t   v; memcpy(&v, (const int8_t*)src + index, 1);   return v < -127 ? -127.0f : (float)v; }
+	case CMF_FORMAT_UBYTE:  { uint8_t  v; memcpy(&v, (const uint8_t*)src + index, 1);  return (float)v; }
+	case CMF_FORMAT_SHORT:  { int16_t  v; memcpy(&v, (const int16_t*)src + index, 2);  return v < -32767 ? -32767.0f : (float)v; }
+	case CMF_FORMAT_USHORT: { uint16_t v; memcpy(&v, (const uint16_t*)src + index, 2); return (float)v; }
+	case CMF_FORMAT_INT:    { int32_t  v; memcpy(&v, (const int32_t*)src + index, 4);  return (float)v; }
+	case CMF_FORMAT_UINT:   { uint32_t v; memcpy(&v, (const uint32_t*)src + index, 4); return (float)v; }
+	case CMF_FORMAT_HALF:   { uint16_t v; memcpy(&v, (const uint16_t*)src + index, 2); return CMF_HalfToFloat(v); }
+	case CMF_FORMAT_FLOAT:  { float    v; memcpy(&v, (const float*)src + index, 4);    return v; }
+	case CMF_FORMAT_DOUBLE: { double   v; memcpy(&v, (const double*)src + index, 8);   return (float)v; }
+	}
+
+	return 0.0f;
+}
+
+#ifdef CMF_SIMD_WIDTH
+// Vector version of CMF_LoadComponent for 4 components of 8 and 16-bit formats
+static inline __m128 CMF_LoadComponents4(const void* src, uint32_t format, uint64_t index)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i v;
+	int32_t bytes;
+
+	switch (format)
+	{
+	case CMF_FORMAT_BYTE:
+		memcpy(&bytes, (const int8_t*)src + index, 4);
+		v = _mm_cvtsi32_si128(bytes);
+		v = _mm_srai_epi32(_mm_unpacklo_epi16(_mm_unpacklo_epi8(v, v), _mm_unpacklo_epi8(v, v)), 24);
+		return _mm_max_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(-127.0f));
+	case CMF_FORMAT_UBYTE:
+		memcpy(&bytes, (const uint8_t*)src + index, 4);
+		v = _mm_cvtsi32_si128(bytes);
+		return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(v, zero), zero));
+	case CMF_FORMAT_SHORT:
+		v = _mm_loadl_epi64((const __m128i*)((const int16_t*)src + index));
+		v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		return _mm_max_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(-32767.0f));
+	case CMF_FORMAT_USHORT:
+		v = _mm_loadl_epi64((const __m128i*)((const uint16_t*)src + index));
+		return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+	case CMF_FORMAT_HALF:
+		v = _mm_loadl_epi64((const __m128i*)((const uint16_t*)src + index));
+#ifdef __F16C__
+		return _mm_cvtph_ps(v);
+#else
+		{
+			// Exponent is rebiased by multiplication, which also normalizes subnormals
+			__m128i expmant = _mm_and_si128(_mm_unpacklo_epi16(v, zero), _mm_set1_epi32(0x7FFF));
+			__m128i sign = _mm_slli_epi32(_mm_xor_si128(_mm_unpacklo_epi16(v, zero), expmant), 16);
+			__m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(expmant, 13)), _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+			__m128i infnan = _mm_and_si128(_mm_cmpgt_epi32(expmant, _mm_set1_epi32(0x7BFF)), _mm_set1_epi32(255 << 23));
+			return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infnan)));
+		}
+#endif
+	}
+
+	return _mm_setzero_ps();
+}
+#endif
+
+/*
+* Converts count components into (component * scale + offset), scale and offset have 12 values,
+* which are repeated along the array, so any count of components from 1 to 4 per vertex may be used.
+*/
+static void CMF_ConvertComponents(const void* src, uint32_t format, uint64_t count, const float* scale, const float* offset, float* out)
+{
+	uint64_t i = 0;
+
+#ifdef CMF_SIMD_WIDTH
+	#define CMF_CONVERT_LOOP(format) \
+		for (; i + 12 <= count; i += 12) \
+		{ \
+			for (int k = 0; k < 3; k++) \
+			{ \
+				__m128 v = CMF_LoadComponents4(src, format, i + k * 4); \
+				_mm_storeu_ps(out + i + k * 4, _mm_add_ps(_mm_mul_ps(v, _mm_loadu_ps(scale + k * 4)), _mm_loadu_ps(offset + k * 4))); \
+			} \
+		}
+
+	// Format is constant in every loop, so switch of CMF_LoadComponents4 is folded
+	switch (format)
+	{
+	case CMF_FORMAT_BYTE:   CMF_CONVERT_LOOP(CMF_FORMAT_BYTE);   break;
+	case CMF_FORMAT_UBYTE:  CMF_CONVERT_LOOP(CMF_FORMAT_UBYTE);  break;
+	case CMF_FORMAT_SHORT:  CMF_CONVERT_LOOP(CMF_FORMAT_SHORT);  break;
+	case CMF_FORMAT_USHORT: CMF_CONVERT_LOOP(CMF_FORMAT_USHORT); break;
+	case CMF_FORMAT_HALF:   CMF_CONVERT_LOOP(CMF_FORMAT_HALF);   break;
+	}
+
+	#undef CMF_CONVERT_LOOP
+#endif
+
+	for (; i < count; i++)
+	{
+		out[i] = CMF_LoadComponent(src, format, i) * scale[i % 12] + offset[i % 12];
+	}
+}
+
+static void CMF_DecodeOctahedral(float x, float y, float* out)
+{
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	float t = z < 0.0f ? -z : 0.0f;
+
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+
+	float length = sqrtf(x * x + y * y + z * z);
+
+	out[0] = x / length;
+	out[1] = y / length;
+	out[2] = z / length;
+}
+
+// Decodes count octahedral vectors of 2 floats in range [-1; 1] into 3 floats of unit vector
+static void CMF_DecodeOctahedralArray(const float* src, uint64_t count, float* out)
+{
+	uint64_t i = 0;
+
+#ifdef CMF_SIMD_WIDTH
+	__m128 sign_mask = _mm_set1_ps(-0.0f);
+	__m128 one = _mm_set1_ps(1.0f);
+
+	// Last vector of every 4 is stored with 16 bytes, so it needs one more vector after them
+	for (; i + 5 <= count; i += 4)
+	{
+		__m128 a = _mm_loadu_ps(src + i * 2);
+		__m128 b = _mm_loadu_ps(src + i * 2 + 4);
+		__m128 x = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 y = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+		__m128 z = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(sign_mask, x)), _mm_andnot_ps(sign_mask, y));
+		__m128 t = _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), z), _mm_setzero_ps());
+
+		// x -= copysign(t, x)
+		x = _mm_sub_ps(x, _mm_or_ps(t, _mm_and_ps(sign_mask, x)));
+		y = _mm_sub_ps(y, _mm_or_ps(t, _mm_and_ps(sign_mask, y)));
+
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+		x = _mm_div_ps(x, length);
+		y = _mm_div_ps(y, length);
+		z = _mm_div_ps(z, length);
+
+		__m128 w = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+
+		float* dst = out + i * 3;
+		_mm_storeu_ps(dst, x);
+		_mm_storeu_ps(dst + 3, y);
+		_mm_storeu_ps(dst + 6, z);
+		_mm_storeu_ps(dst + 9, w);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		CMF_DecodeOctahedral(src[i * 2], src[i * 2 + 1], out + i * 3);
+	}
+}
+
+#define CMF_OCTAHEDRAL_CHUNK 256
+
+/*!
+* @brief Converts array of any format into floats.
+*
+* Normalized formats (BYTE, UBYTE, SHORT, USHORT) of positions are mapped onto bounding box,
+* of other types they are mapped onto [-1; 1] or [0; 1]. Normals and tangents of 2 components
+* are octahedral-encoded unit vectors and are decoded into 3 floats.
+*
+* @param array Array to convert.
+* @param num_vertices Count of vertices in array.
+* @param bounds Data of CMF_TYPE_BOUNDS array, needed only for normalized positions.
+* @param out Output buffer of (num_vertices * CMF_DequantizedComponents(array, num_vertices)) floats.
+* @return Returns 0 if array was converted, otherwise returns -1.
+*/
+int CMF_DequantizeArray(const struct CMF_InfoArray* array, uint32_t num_vertices, const float* bounds, float* out)
+{
+	uint32_t components = CMF_ArrayComponents(array, num_vertices);
+	if (components == 0) return -1;
+
+	int normalized = array->format <= CMF_FORMAT_USHORT;
+	int is_signed = array->format == CMF_FORMAT_BYTE || array->format == CMF_FORMAT_SHORT;
+	float max_value = array->format == CMF_FORMAT_BYTE ? 127.0f : array->format == CMF_FORMAT_UBYTE ? 255.0f :
+	                  array->format == CMF_FORMAT_SHORT ? 32767.0f : 65535.0f;
+
+	float scale[12];
+	float offset[12];
+
+	for (int i = 0; i < 12; i++)
+	{
+		uint32_t component = i % components;
+		scale[i] = normalized ? 1.0f / max_value : 1.0f;
+		offset[i] = 0.0f;
+
+		if (normalized && array->type == CMF_TYPE_POSITION)
+		{
+			if (bounds == NULL || component >= 3) return -1;
+
+			// Unsigned values cover box from min to max, signed ones cover it from center
+			float extent = bounds[component + 3] - bounds[component];
+			scale[i] = is_signed ? extent * 0.5f / max_value : extent / max_value;
+			offset[i] = is_signed ? (bounds[component] + bounds[component + 3]) * 0.5f : bounds[component];
+		}
+	}
+
+	uint64_t count = (uint64_t)num_vertices * components;
+
+	if (components > 4)
+	{
+		for (uint64_t i = 0; i < count; i++) out[i] = CMF_LoadComponent(array->data, array->format, i) * scale[0] + offset[0];
+		return 0;
+	}
+
+	if (!CMF_IsOctahedral(array->type, components))
+	{
+		CMF_ConvertComponents(array->data, array->format, count, scale, offset, out);
+		return 0;
+	}
+
+	// Octahedral vectors are converted into floats by chunks, which are decoded in place
+	float chunk[CMF_OCTAHEDRAL_CHUNK * 2];
+
+	for (uint64_t vertex = 0; vertex < num_vertices; vertex += CMF_OCTAHEDRAL_CHUNK)
+	{
+		uint64_t size = num_vertices - vertex < CMF_OCTAHEDRAL_CHUNK ? num_vertices - vertex : CMF_OCTAHEDRAL_CHUNK;
+		const uint8_t* src = (const uint8_t*)array->data + vertex * 2 * CMF_FormatSize(array->format);
+
+		CMF_ConvertComponents(src, array->format, size * 2, scale, offset, chunk);
+		CMF_DecodeOctahedralArray(chunk, size, out + vertex * 3);
+	}
+
+	return 0;
+}
+
+// Size of array converted by CMF_Dequantize, 0 if array is kept as is
+static uint64_t CMF_DequantizedSize(const struct CMF_InfoArray* array, uint32_t num_vertices)
+{
+	if (array->type > CMF_TYPE_COLOR) return 0;
+
+	uint32_t components = CMF_DequantizedComponents(array, num_vertices);
+	if (array->format == CMF_FORMAT_FLOAT && components == CMF_ArrayComponents(array, num_vertices)) return 0;
+
+	return (uint64_t)num_vertices * components * sizeof(float);
+}
+
+static int CMF_DequantizeWith(struct CMF_Info* info, const struct CMF_Allocator* allocator)
+{
+	const float* bounds = NULL;
+
+	for (uint32_t array = 0; array < info->num_arrays; array++)
+	{
+		const struct CMF_InfoArray* arr = &info->arrays[array];
+		if (arr->type == CMF_TYPE_BOUNDS && arr->format == CMF_FORMAT_FLOAT && arr->size == 6 * sizeof(float)) bounds = (const float*)arr->data;
+	}
+
+	for (uint32_t array = 0; array < info->num_arrays; array++)
+	{
+		struct CMF_InfoArray* arr = &info->arrays[array];
+		if (arr->type > CMF_TYPE_COLOR) continue;
+
+		uint32_t components = CMF_DequantizedComponents(arr, info->num_vertices);
+		if (components == 0) return -1;
+		if (arr->format == CMF_FORMAT_FLOAT && components == CMF_ArrayComponents(arr, info->num_vertices)) continue;
+
+		uint64_t size = (uint64_t)info->num_vertices * components * sizeof(float);
+		float* out = size <= UINT32_MAX ? (float*)CMF_Alloc(allocator, (size_t)size) : NULL;
+
+		if (out == NULL || CMF_DequantizeArray(arr, info->num_vertices, bounds, out) != 0)
+		{
+			CMF_Free(allocator, out);
+			return -1;
+		}
+
+		CMF_Free(allocator, arr->data);
+		arr->data = out;
+		arr->format = CMF_FORMAT_FLOAT;
+		arr->size = (uint32_t)size;
+	}
+
+	return 0;
+}
+
+/*!
+* @brief Converts every quantized vertex array of info into floats with CMF_DequantizeArray.
+*
+* Data of arrays must be allocated with malloc as CMF_Load2 does, converted arrays are replaced.
+* Only arrays of vertex attributes (from position to color) are converted.
+*
+* @return Returns 0 if arrays were converted, otherwise returns -1.
+*/
+int CMF_Dequantize(struct CMF_Info* info)
+{
+	return CMF_DequantizeWith(info, NULL);
+}
+
+/*!
+* @brief Parameters of CMF_Load2Ex.
+*/
+struct CMF_LoadParams
+{
+	uint32_t num_threads;        ///< Count of decompression threads, 0 to use all hardware threads.
+	struct CMF_Context* context; ///< Reused ZSTD state with dictionaries, NULL to create temporary one.
+	int dequantize;              ///< Convert quantized arrays into floats with CMF_Dequantize.
+	uint32_t types;              ///< CMF_TYPE_BIT of every loaded type, other arrays are skipped without reading, 0 for all types.
+	const struct CMF_Allocator* allocator; ///< Allocator of arrays, NULL for malloc and free.
+	int arena;                   ///< Place table of arrays and every array into one block, which starts at info->arrays.
+};
+
+/*!
+* @brief Parameters of CMF_Save2Ex.
+*/
+struct CMF_SaveParams
+{
+	int      level;              ///< ZSTD compression level, used only with CMF_COMPRESSION_ZSTD.
+	uint32_t num_threads;        ///< Count of compression threads, 0 to use all hardware threads.
+	uint32_t block_size;         ///< Arrays are split into independent ZSTD frames of this uncompressed size.
+	struct CMF_Context* context; ///< Reused ZSTD state with dictionaries, NULL to create temporary one.
+	uint32_t toc;                ///< Write table of contents, CMF_OpenWriter reserves entries for this count of arrays.
+};
+
+void CMF_DefaultLoadParams(struct CMF_LoadParams* params)
+{
+	params->num_threads = 0;
+	params->context = NULL;
+	params->dequantize = 0;
+	params->types = CMF_ALL_TYPES;
+	params->allocator = NULL;
+	params->arena = 0;
+}
+
+void CMF_DefaultSaveParams(struct CMF_SaveParams* params)
+{
+	params->level = CMF_DEFAULT_COMPRESSION_LEVEL;
+	params->num_threads = 0;
+	params->block_size = CMF_DEFAULT_BLOCK_SIZE;
+	params->context = NULL;
+	params->toc = 0;
+}
+
+/*
+* Runs func for every task on num_threads threads, calling thread takes part in work too.
+* Thread index passed to func is less than num_threads, so it may be used to index per-thread data.
+*/
+static void CMF_ParallelFor(uint32_t num_tasks, uint32_t num_threads, void (*func)(void* user, uint32_t task, uint32_t thread), void* user)
+{
+	if (num_threads == 0) num_threads = std::thread::hardware_concurrency();
+	if (num_threads > num_tasks) num_threads = num_tasks;
+
+	if (num_threads <= 1)
+	{
+		for (uint32_t task = 0; task < num_tasks; task++) func(user, task, 0);
+		return;
+	}
+
+	std::atomic<uint32_t> next(0);
+	auto worker = [&](uint32_t thread)
+	{
+		for (uint32_t task = next++; task < num_tasks; task = next++) func(user, task, thread);
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(num_threads - 1);
+
+	for (uint32_t thread = 1; thread < num_threads; thread++) threads.emplace_back(worker, thread);
+	worker(0);
+	for (auto& thread : threads) thread.join();
+}
+
+/*
+* With CMF_COMPRESSION_ZSTD every array is stored as 32-bit size of uncompressed data
+* followed by ZSTD frames, CMF_ArrayHeader::size is a size of stored data.
+* Every frame is independent, so large arrays are compressed and decompressed in parallel.
+*/
+static int CMF_IsCompressedArray(const uint8_t* data, uint32_t size)
+{
+	//Files written before compression was implemented carry the flag with raw arrays
+	uint32_t magic = 0;
+	if (size < sizeof(uint32_t) * 2) return 0;
+	memcpy(&magic, data + sizeof(uint32_t), sizeof(magic));
+	return magic == ZSTD_MAGICNUMBER;
+}
+
+struct CMF_Block
+{
+	const uint8_t* src;
+	size_t src_size;
+	uint8_t* dst;
+	size_t dst_size;
+	const ZSTD_CDict* cdict;
+	const ZSTD_DDict* ddict;
+	int error;
+};
+
+struct CMF_BlockJob
+{
+	struct CMF_Block* blocks;
+	ZSTD_CCtx** cctxs;
+	ZSTD_DCtx** dctxs;
+	uint32_t num_threads;
+	int owns_contexts;
+	int level;
+};
+
+static void CMF_FreeBlockJob(struct CMF_BlockJob* job)
+{
+	if (job->owns_contexts)
+	{
+		for (uint32_t thread = 0; thread < job->num_threads; thread++)
+		{
+			if (job->cctxs != NULL) ZSTD_freeCCtx(job->cctxs[thread]);
+			if (job->dctxs != NULL) ZSTD_freeDCtx(job->dctxs[thread]);
+		}
+
+		free(job->cctxs);
+		free(job->dctxs);
+	}
+
+	free(job->blocks);
+	memset(job, 0, sizeof(struct CMF_BlockJob));
+}
+
+/*
+* ZSTD contexts are borrowed from caller context if it is passed, then count of threads is limited by it.
+*/
+static int CMF_InitBlockJob(struct CMF_BlockJob* job, uint32_t num_blocks, uint32_t num_threads, struct CMF_Context* context, int level)
+{
+	memset(job, 0, sizeof(struct CMF_BlockJob));
+	job->blocks = (struct CMF_Block*)calloc(num_blocks, sizeof(struct CMF_Block));
+	job->level = level;
+
+	if (context != NULL)
+	{
+		job->cctxs = context->cctxs;
+		job->dctxs = context->dctxs;
+		job->num_threads = num_threads < context->num_threads ? num_threads : context->num_threads;
+	}
+	else
+	{
+		job->cctxs = (ZSTD_CCtx**)calloc(num_threads, sizeof(ZSTD_CCtx*));
+		job->dctxs = (ZSTD_DCtx**)calloc(num_threads, sizeof(ZSTD_DCtx*));
+		job->num_threads = num_threads;
+		job->owns_contexts = 1;
+	}
+
+	if (job->blocks == NULL || job->cctxs == NULL || job->dctxs == NULL) { CMF_FreeBlockJob(job); return -1; }
+
+	return 0;
+}
+
+static void CMF_CompressBlock(void* user, uint32_t task, uint32_t thread)
+{
+	struct CMF_BlockJob* job = (struct CMF_BlockJob*)user;
+	struct CMF_Block* block = &job->blocks[task];
+
+	if (job->cctxs[thread] == NULL) job->cctxs[thread] = ZSTD_createCCtx();
+	if (job->cctxs[thread] == NULL) { block->error = 1; return; }
+
+	size_t result = block->cdict != NULL
+		? ZSTD_compress_usingCDict(job->cctxs[thread], block->dst, block->dst_size, block->src, block->src_size, block->cdict)
+		: ZSTD_compressCCtx(job->cctxs[thread], block->dst, block->dst_size, block->src, block->src_size, job->level);
+
+	block->error = ZSTD_isError(result);
+	block->dst_size = result;
+}
+
+static void CMF_DecompressBlock(void* user, uint32_t task, uint32_t thread)
+{
+	struct CMF_BlockJob* job = (struct CMF_BlockJob*)user;
+	struct CMF_Block* block = &job->blocks[task];
+
+	if (job->dctxs[thread] == NULL) job->dctxs[thread] = ZSTD_createDCtx();
+	if (job->dctxs[thread] == NULL) { block->error = 1; return; }
+
+	size_t result = block->ddict != NULL
+		? ZSTD_decompress_usingDDict(job->dctxs[thread], block->dst, block->dst_size, block->src, block->src_size, block->ddict)
+		: ZSTD_decompressDCtx(job->dctxs[thread], block->dst, block->dst_size, block->src, block->src_size);
+
+	block->error = ZSTD_isError(result) || result != block->dst_size;
+}
+
+static int CMF_RunBlockJob(struct CMF_BlockJob* job, uint32_t num_blocks, void (*func)(void* user, uint32_t task, uint32_t thread))
+{
+	CMF_ParallelFor(num_blocks, job->num_threads, func, job);
+
+	for (uint32_t block = 0; block < num_blocks; block++)
+	{
+		if (job->blocks[block].error) return -1;
+	}
+
+	return 0;
+}
+
+static uint32_t CMF_CountBlocks(uint32_t size, uint32_t block_size)
+{
+	return size == 0 ? 1 : (size - 1) / block_size + 1;
+}
+
+static size_t CMF_BlocksBound(uint32_t size, uint32_t block_size)
+{
+	return ZSTD_compressBound(size < block_size ? size : block_size) * CMF_CountBlocks(size, block_size);
+}
+
+/*
+* Splits data into blocks of block_size bytes, compressed blocks are placed one after another in dst.
+* Returns end of the space reserved for compressed blocks.
+*/
+static uint8_t* CMF_FillBlocks(struct CMF_Block* blocks, const uint8_t* src, uint32_t size, uint32_t block_size, uint8_t* dst, const ZSTD_CDict* cdict)
+{
+	uint32_t block = 0;
+
+	do
+	{
+		uint32_t block_bytes = size < block_size ? size : block_size;
+		blocks[block++] = { src, block_bytes, dst, ZSTD_compressBound(block_bytes), cdict, NULL, 0 };
+
+		dst += ZSTD_compressBound(block_bytes);
+		src += block_bytes;
+		size -= block_bytes;
+	} while (size > 0);
+
+	return dst;
+}
+
+static const ZSTD_CDict* CMF_FindTypeDictionary(const struct CMF_Context* context, uint32_t type)
+{
+	// Levels of detail share dictionary of their type
+	type = CMF_TYPE_BASE(type);
+	return (context != NULL && type < CMF_MAX_DICTIONARIES) ? context->cdicts[type] : NULL;
+}
+
+/*
+* Splits ZSTD frames of stored array into blocks, blocks may be NULL to only count them.
+* Frames without content size cannot be placed independently, then whole array is one block.
+*/
+static int CMF_SplitFrames(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size, struct CMF_Block* blocks)
+{
+	int count = 0;
+	size_t src_offset = 0;
+	size_t dst_offset = 0;
+
+	while (src_offset < src_size)
+	{
+		size_t frame_size = ZSTD_findFrameCompressedSize(src + src_offset, src_size - src_offset);
+		unsigned long long content_size = ZSTD_getFrameContentSize(src + src_offset, src_size - src_offset);
+		if (ZSTD_isError(frame_size)) return -1;
+
+		if (content_size == ZSTD_CONTENTSIZE_UNKNOWN || content_size == ZSTD_CONTENTSIZE_ERROR)
+		{
+			if (blocks != NULL) blocks[0] = { src, src_size, dst, dst_size, NULL, NULL, 0 };
+			return 1;
+		}
+
+		if (blocks != NULL)
+		{
+			if (content_size > dst_size - dst_offset) return -1;
+			blocks[count] = { src + src_offset, frame_size, dst + dst_offset, (size_t)content_size, NULL, NULL, 0 };
+		}
+
+		src_offset += frame_size;
+		dst_offset += content_size;
+		count++;
+	}
+
+	return (blocks == NULL || dst_offset == dst_size) ? count : -1;
+}
+
+/*
+* Frees arrays of info and their table, memory inside of arena block is released only with the block,
+* which is the table of arrays in arena mode.
+*/
+static void CMF_FreeArrays(struct CMF_Info* info, const struct CMF_Allocator* allocator, const struct CMF_Arena* arena)
+{
+	for (uint32_t array = 0; array < info->num_arrays; array++)
+	{
+		const uint8_t* data = (const uint8_t*)info->arrays[array].data;
+		if (arena != NULL && data >= arena->base && data < arena->base + arena->size) continue;
+
+		CMF_Free(allocator, info->arrays[array].data);
+	}
+
+	CMF_Free(allocator, info->arrays);
+	info->arrays = NULL;
+	info->num_arrays = 0;
+}
+
+/*
+* Decompresses every compressed array of info in parallel, stored[array] holds data read from file.
+* Stored data is owned by caller. Arrays without data are allocated, others are decompressed into their data.
+*/
+static int CMF_DecompressArrays(struct CMF_Info* info, uint8_t** stored, uint32_t num_threads, struct CMF_Context* context, const struct CMF_Allocator* allocator)
+{
+	int num_blocks = 0;
+
+	for (uint32_t array = 0; array < info->num_arrays; array++)
+	{
+		if (stored[array] == NULL) continue;
+
+		int count = CMF_SplitFrames(stored[array] + sizeof(uint32_t), info->arrays[array].size - sizeof(uint32_t), NULL, 0, NULL);
+		if (count < 0) return -1;
+		num_blocks += count;
+	}
+
+	if (num_blocks == 0) return 0;
+
+	struct CMF_BlockJob job;
+	if (CMF_InitBlockJob(&job, num_blocks, num_threads, context, 0) != 0) return -1;
+
+	int block = 0;
+	int result = 0;
+
+	for (uint32_t array = 0; array < info->num_arrays; array++)
+	{
+		if (stored[array] == NULL) continue;
+
+		uint32_t decompressed_size = 0;
+		memcpy(&decompressed_size, stored[array], sizeof(decompressed_size));
+
+		if (info->arrays[array].data == NULL) info->arrays[array].data = CMF_Alloc(allocator, decompressed_size);
+		if (info->arrays[array].data == NULL && decompressed_size != 0) { result = -1; break; }
+
+		int count = CMF_SplitFrames(stored[array] + sizeof(uint32_t), info->arrays[array].size - sizeof(uint32_t),
+		                            (uint8_t*)info->arrays[array].data, decompressed_size, job.blocks + block);
+		if (count < 0) { result = -1; break; }
+
+		for (int i = block; i < block + count; i++)
+		{
+			job.blocks[i].ddict = CMF_FindDictionary(context, ZSTD_getDictID_fromFrame(job.blocks[i].src, job.blocks[i].src_size));
+		}
+
+		info->arrays[array].size = decompressed_size;
+		block += count;
+	}
+
+	if (result == 0)
+	{
+		result = CMF_RunBlockJob(&job, num_blocks, CMF_DecompressBlock);
+	}
+
+	CMF_FreeBlockJob(&job);
+
+	return result;
+}
+
+static int CMF_IsTypeLoaded(uint32_t types, uint32_t type)
+{
+	// Zero mask is left by zeroed params, it loads everything as CMF_ALL_TYPES
+	if (types == 0 || types == CMF_ALL_TYPES) return 1;
+	return CMF_TYPE_BASE(type) < 32 && (types & CMF_TYPE_BIT(type)) != 0;
+}
+
+#ifdef _WIN32
+	#define CMF_FSEEK _fseeki64
+	#define CMF_FTELL _ftelli64
+#else
+	#define CMF_FSEEK fseeko
+	#define CMF_FTELL ftello
+#endif
+
+/*
+* Reads data at offset of file without moving its position, so arrays may be read in parallel.
+*/
+static int CMF_ReadAt(FILE* fp, void* data, size_t size, uint64_t offset)
+{
+	uint8_t* dst = (uint8_t*)data;
+
+#ifdef _WIN32
+	HANDLE file = (HANDLE)_get_osfhandle(_fileno(fp));
+
+	while (size > 0)
+	{
+		OVERLAPPED overlapped;
+		memset(&overlapped, 0, sizeof(overlapped));
+		overlapped.Offset = (DWORD)offset;
+		overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+		DWORD count = 0;
+		if (!ReadFile(file, dst, size > 0x40000000 ? 0x40000000 : (DWORD)size, &count, &overlapped) || count == 0) return -1;
+
+		dst += count;
+		offset += count;
+		size -= count;
+	}
+#else
+	int fd = fileno(fp);
+
+	while (size > 0)
+	{
+		ssize_t count = pread(fd, dst, size, (off_t)offset);
+		if (count < 0 && errno == EINTR) continue;
+		if (count <= 0) return -1;
+
+		dst += count;
+		offset += count;
+		size -= count;
+	}
+#endif
+
+	return 0;
+}
+
+/*
+* Reads stored data of arrays of loaded types one by one, skipping the rest.
+*/
+static int CMF_ReadArrays(FILE* fp, const struct CMF_Header* header, struct CMF_Info* info, uint32_t types, const struct CMF_Allocator* allocator)
+{
+	for (uint32_t i = 0; i < header->num_arrays; i++)
+	{
+		struct CMF_ArrayHeader arr_header;
+		if (fread(&arr_header, sizeof(arr_header), 1, fp) != 1) return -1;
+		CMF_STATS_ADD(bytes_read, sizeof(arr_header));
+
+		if (!CMF_IsTypeLoaded(types, arr_header.type))
+		{
+			if (CMF_FSEEK(fp, arr_header.size, SEEK_CUR) != 0) return -1;
+			continue;
+		}
+
+		struct CMF_InfoArray* array = &info->arrays[info->num_arrays++];
+		array->type = arr_header.type;
+		array->format = arr_header.format;
+		array->size = arr_header.size;
+		array->data = CMF_Alloc(allocator, arr_header.size);
+
+		if (arr_header.size != 0 && (array->data == NULL || fread(array->data, arr_header.size, 1, fp) != 1)) return -1;
+		CMF_STATS_ADD(bytes_read, arr_header.size);
+	}
+
+	return 0;
+}
+
+struct CMF_ReadJob
+{
+	FILE* fp;
+	struct CMF_Info* info;
+	const uint64_t* offsets;
+	std::atomic<int> error;
+};
+
+static void CMF_ReadArrayTask(void* user, uint32_t task, uint32_t thread)
+{
+	struct CMF_ReadJob* job = (struct CMF_ReadJob*)user;
+	struct CMF_InfoArray* array = &job->info->arrays[task];
+	(void)thread;
+
+	if (CMF_ReadAt(job->fp, array->data, array->size, job->offsets[task]) != 0) job->error = 1;
+}
+
+/*
+* Reads stored data of arrays of loaded types at offsets from table of contents,
+* every array is one positioned read and arrays are read on num_threads threads.
+*/
+static int CMF_ReadArraysToc(FILE* fp, const struct CMF_Header* header, struct CMF_Info* info, uint32_t types, uint32_t num_threads, const struct CMF_Allocator* allocator)
+{
+	struct CMF_Toc toc;
+	if (fread(&toc, sizeof(toc), 1, fp) != 1 || toc.capacity < header->num_arrays) return -1;
+
+	struct CMF_TocEntry* entries = (struct CMF_TocEntry*)malloc(header->num_arrays * sizeof(struct CMF_TocEntry));
+	uint64_t* offsets = (uint64_t*)malloc(header->num_arrays * sizeof(uint64_t));
+	int result = 0;
+
+	if (header->num_arrays != 0 && (entries == NULL || offsets == NULL ||
+	    fread(entries, sizeof(struct CMF_TocEntry), header->num_arrays, fp) != header->num_arrays))
+	{
+		result = -1;
+	}
+
+	CMF_STATS_ADD(bytes_read, sizeof(toc) + header->num_arrays * sizeof(struct CMF_TocEntry));
+
+	for (uint32_t i = 0; i < header->num_arrays && result == 0; i++)
+	{
+		if (!CMF_IsTypeLoaded(types, entries[i].type)) continue;
+
+		offsets[info->num_arrays] = entries[i].offset;
+
+		struct CMF_InfoArray* array = &info->arrays[info->num_arrays++];
+		array->type = entries[i].type;
+		array->format = entries[i].format;
+		array->size = entries[i].stored_size;
+		array->data = CMF_Alloc(allocator, entries[i].stored_size);
+
+		if (array->data == NULL && entries[i].stored_size != 0) result = -1;
+		CMF_STATS_ADD(bytes_read, entries[i].stored_size);
+	}
+
+	if (result == 0)
+	{
+		struct CMF_ReadJob job;
+		job.fp = fp;
+		job.info = info;
+		job.offsets = offsets;
+		job.error = 0;
+
+		CMF_ParallelFor(info->num_arrays, num_threads, CMF_ReadArrayTask, &job);
+		result = job.error ? -1 : 0;
+	}
+
+	free(entries);
+	free(offsets);
+
+	return result;
+}
+
+static int CMF_IsInside(const void* pointer, const uint8_t* base, size_t size)
+{
+	return base != NULL && (const uint8_t*)pointer >= base && (const uint8_t*)pointer < base + size;
+}
+
+/*
+* Turns stored data of arrays into loaded arrays: compressed arrays are decompressed and quantized ones
+* are dequantized if requested. In arena mode one block is sized from headers of arrays, table of arrays
+* is placed at its beginning and every array follows it. Data inside of read buffer is not owned, so it is copied.
+* Arrays are freed if error was occured.
+*/
+static int CMF_FinishArrays(struct CMF_Info* info, const uint8_t* buffer, size_t length, uint32_t num_threads,
+                            const struct CMF_LoadParams* params, struct CMF_Context* context)
+{
+	const struct CMF_Allocator* allocator = params->allocator;
+	const struct CMF_Allocator* target = allocator;
+
+	struct CMF_Arena arena = { NULL, 0, 0 };
+	struct CMF_Allocator arena_allocator = { CMF_ArenaAlloc, CMF_ArenaFree, &arena };
+
+	uint8_t** stored = (uint8_t**)calloc(info->num_arrays + 1, sizeof(uint8_t*));
+	int result = stored != NULL ? 0 : -1;
+	int compressed = 0;
+
+	for (uint32_t array = 0; array < info->num_arrays && result == 0; array++)
+	{
+		struct CMF_InfoArray* arr = &info->arrays[array];
+
+		if (info->compression == CMF_COMPRESSION_ZSTD && CMF_IsCompressedArray((const uint8_t*)arr->data, arr->size))
+		{
+			stored[array] = (uint8_t*)arr->data;
+			arr->data = NULL;
+			compressed = 1;
+		}
+
+#ifdef CMF_ENABLE_STATS
+		uint32_t size = arr->size;
+		if (stored[array] != NULL) memcpy(&size, stored[array], sizeof(size));
+		CMF_STATS_ARRAY(arr->type, arr->format, arr->size, size);
+#endif
+	}
+
+	CMF_STATS_TIMER(repack_begin);
+
+	if (result == 0 && params->arena)
+	{
+		size_t table_size = info->num_arrays * sizeof(struct CMF_InfoArray);
+		size_t size = table_size;
+
+		for (uint32_t array = 0; array < info->num_arrays; array++)
+		{
+			struct CMF_InfoArray loaded = info->arrays[array];
+			if (stored[array] != NULL) memcpy(&loaded.size, stored[array], sizeof(loaded.size));
+
+			size += loaded.size + CMF_ARRAY_ALIGNMENT;
+			if (params->dequantize) size += CMF_DequantizedSize(&loaded, info->num_vertices) + CMF_ARRAY_ALIGNMENT;
+		}
+
+		arena.base = (uint8_t*)CMF_Alloc(allocator, size);
+		arena.size = size;
+		arena.used = table_size;
+
+		if (arena.base != NULL)
+		{
+			memcpy(arena.base, info->arrays, table_size);
+			CMF_Free(allocator, info->arrays);
+			info->arrays = (struct CMF_InfoArray*)arena.base;
+			target = &arena_allocator;
+		}
+		else result = -1;
+	}
+
+	// Raw arrays are moved into arena and copied out of read buffer
+	for (uint32_t array = 0; array < info->num_arrays && result == 0; array++)
+	{
+		struct CMF_InfoArray* arr = &info->arrays[array];
+		int inside = CMF_IsInside(arr->data, buffer, length);
+
+		if (stored[array] != NULL || (!params->arena && !inside)) continue;
+
+		void* data = CMF_Alloc(target, arr->size);
+		if (data == NULL && arr->size != 0) { result = -1; break; }
+		if (arr->size != 0) memcpy(data, arr->data, arr->size);
+
+		if (!inside) CMF_Free(allocator, arr->data);
+		arr->data = data;
+	}
+
+	CMF_STATS_TIME(repack_seconds, repack_begin);
+	CMF_STATS_TIMER(zstd_begin);
+
+	if (result == 0 && compressed) result = CMF_DecompressArrays(info, stored, num_threads, context, target);
+
+	CMF_STATS_TIME(zstd_seconds, zstd_begin);
+
+	for (uint32_t array = 0; array < info->num_arrays && stored != NULL; array++)
+	{
+		if (!CMF_IsInside(stored[array], buffer, length)) CMF_Free(allocator, stored[array]);
+	}
+
+	free(stored);
+
+	CMF_STATS_TIMER(dequantize_begin);
+	if (result == 0 && params->dequantize) result = CMF_DequantizeWith(info, target);
+	CMF_STATS_TIME(repack_seconds, dequantize_begin);
+
+	if (result != 0)
+	{
+		for (uint32_t array = 0; array < info->num_arrays; array++)
+		{
+			if (CMF_IsInside(info->arrays[array].data, buffer, length)) info->arrays[array].data = NULL;
+		}
+
+		CMF_FreeArrays(info, allocator, &arena);
+	}
+
+	return result;
+}
+
+/*!
+* @brief Loads CMF file of version 1.
+*
+* Compressed arrays are decompressed on params->num_threads threads.
+* Only arrays of params->types are read, data of other arrays is skipped,
+* so info->num_arrays may be less than count of arrays in file.
+* If file has table of contents, arrays are read in parallel by their offsets.
+*
+* @param filename Name of file, which would be read.
+* @param info Valid pointer to info which would be filled, every array must be freed by caller.
+* @param params Load parameters, NULL for defaults.
+* @return Returns 0 if loading was successful, otherwise returns -1.
+*/
+int CMF_Load2Ex(const char* filename, struct CMF_Info* info, const struct CMF_LoadParams* params)
+{
+	struct CMF_LoadParams defaults;
+	if (params == NULL) { CMF_DefaultLoadParams(&defaults); params = &defaults; }
+
+	CMF_STATS_SCOPE(CMF_STATS_LOAD, filename);
+	CMF_STATS_TIMER(open_begin);
+
+	FILE* fp = fopen(filename, "rb");
+	if (fp == NULL) return -1;
+
+	CMF_Header header;
+
+	if (fread(&header, sizeof(header), 1, fp) != 1) { fclose(fp); return -1; }
+	CMF_STATS_ADD(bytes_read, sizeof(header));
+	CMF_STATS_TIME(open_seconds, open_begin);
+
+	if (memcmp(header.magic, CMF_MAGIC_STRING, 24) != 0) { fclose(fp); return -1; }
+	if (header.version != 1) { fclose(fp); return -1; }
+
+	info->compression = header.compression;
+	info->num_vertices = header.num_vertices;
+	info->num_arrays = 0;
+	info->arrays = (struct CMF_InfoArray*)CMF_Alloc(params->allocator, header.num_arrays * sizeof(CMF_InfoArray));
+	if (info->arrays == NULL && header.num_arrays != 0) { fclose(fp); return -1; }
+
+	// Normalized positions can't be dequantized without their bounds
+	uint32_t types = params->types;
+	if (params->dequantize && (types & CMF_TYPE_BIT(CMF_TYPE_POSITION))) types |= CMF_TYPE_BIT(CMF_TYPE_BOUNDS);
+
+	uint32_t num_threads = CMF_NumThreads(params->num_threads);
+
+	CMF_STATS_TIMER(io_begin);
+	int result = (header.flags & CMF_FLAG_TOC) ? CMF_ReadArraysToc(fp, &header, info, types, num_threads, params->allocator)
+	                                           : CMF_ReadArrays(fp, &header, info, types, params->allocator);
+
+	fclose(fp);
+	CMF_STATS_TIME(io_seconds, io_begin);
+
+	if (result != 0)
+	{
+		CMF_FreeArrays(info, params->allocator, NULL);
+		return -1;
+	}
+
+	return CMF_STATS_RESULT(CMF_FinishArrays(info, NULL, 0, num_threads, params, params->context));
+}
+
+int CMF_Load2(const char* filename, struct CMF_Info* info)
+{
+	return CMF_Load2Ex(filename, info, NULL);
+}
+
+/*!
+* @brief Frees arrays of info loaded with CMF_Load2Ex or CMF_LoadAsync.
+*
+* @param info Loaded info.
+* @param params Parameters which info was loaded with, NULL for defaults.
+*/
+void CMF_FreeInfo(struct CMF_Info* info, const struct CMF_LoadParams* params)
+{
+	struct CMF_LoadParams defaults;
+	if (params == NULL) { CMF_DefaultLoadParams(&defaults); params = &defaults; }
+
+	if (params->arena)
+	{
+		CMF_Free(params->allocator, info->arrays);
+		info->arrays = NULL;
+		info->num_arrays = 0;
+		return;
+	}
+
+	CMF_FreeArrays(info, params->allocator, NULL);
+}
+
+/*!
+* @brief Returns alignment of data of loaded array, which is needed to access it as its format.
+*/
+uint32_t CMF_ArrayAlignment(const struct CMF_InfoArray* array)
+{
+	uint32_t size = CMF_FormatSize(array->format);
+	return size != 0 ? size : 1;
+}
+
+/*!
+* @brief Reader which loads arrays of CMF file of version 1 into buffers of caller.
+*
+* CMF_OpenReader reads only headers of arrays and returns size of every loaded array, then
+* CMF_ReaderRead reads, decompresses and dequantizes arrays right into given buffers,
+* for example into persistently mapped upload buffers, so arrays are never copied again.
+*/
+struct CMF_Reader
+{
+	FILE* fp;
+	struct CMF_LoadParams params;
+	uint32_t compression;
+	uint32_t num_vertices;
+	uint32_t num_arrays;
+	struct CMF_InfoArray* arrays; ///< Loaded arrays, table is given to caller
+	struct CMF_TocEntry* entries; ///< Stored arrays, size is a size before dequantization
+	uint8_t* compressed;
+};
+
+/*
+* Collects entries of loaded types from table of contents or from headers of arrays,
+* loaded size of compressed array is read from its prefix.
+*/
+static int CMF_ReaderEntries(struct CMF_Reader* reader, const struct CMF_Header* header, uint32_t types)
+{
+	struct CMF_TocEntry* entries = reader->entries;
+
+	if (header->flags & CMF_FLAG_TOC)
+	{
+		struct CMF_Toc toc;
+		if (fread(&toc, sizeof(toc), 1, reader->fp) != 1 || toc.capacity < header->num_arrays) return -1;
+		if (fread(entries, sizeof(struct CMF_TocEntry), header->num_arrays, reader->fp) != header->num_arrays) return -1;
+		CMF_STATS_ADD(bytes_read, sizeof(toc) + header->num_arrays * sizeof(struct CMF_TocEntry));
+	}
+	else
+	{
+		uint64_t offset = sizeof(struct CMF_Header);
+
+		for (uint32_t i = 0; i < header->num_arrays; i++)
+		{
+			struct CMF_ArrayHeader arr_header;
+			if (fread(&arr_header, sizeof(arr_header), 1, reader->fp) != 1) return -1;
+			if (CMF_FSEEK(reader->fp, arr_header.size, SEEK_CUR) != 0) return -1;
+			CMF_STATS_ADD(bytes_read, sizeof(arr_header));
+
+			offset += sizeof(arr_header);
+			entries[i] = { arr_header.type, arr_header.format, offset, arr_header.size, arr_header.size };
+			offset += arr_header.size;
+		}
+	}
+
+	for (uint32_t i = 0; i < header->num_arrays; i++)
+	{
+		if (!CMF_IsTypeLoaded(types, entries[i].type)) continue;
+
+		struct CMF_TocEntry entry = entries[i];
+		uint8_t prefix[sizeof(uint32_t) * 2];
+		int compressed = 0;
+
+		if (header->compression == CMF_COMPRESSION_ZSTD && entry.stored_size >= sizeof(prefix))
+		{
+			if (CMF_ReadAt(reader->fp, prefix, sizeof(prefix), entry.offset) != 0) return -1;
+			CMF_STATS_ADD(bytes_read, sizeof(prefix));
+			compressed = CMF_IsCompressedArray(prefix, sizeof(prefix));
+		}
+
+		if (compressed) memcpy(&entry.size, prefix, sizeof(entry.size));
+		else entry.size = entry.stored_size;
+
+		reader->compressed[reader->num_arrays] = (uint8_t)compressed;
+		reader->entries[reader->num_arrays++] = entry;
+	}
+
+	return 0;
+}
+
+/*!
+* @brief Closes reader, table of arrays returned by CMF_OpenReader is freed too.
+*/
+void CMF_CloseReader(struct CMF_Reader* reader)
+{
+	if (reader->fp != NULL) fclose(reader->fp);
+	free(reader->arrays);
+	free(reader->entries);
+	free(reader->compressed);
+	free(reader);
+}
+
+/*!
+* @brief Opens reader of CMF file of version 1 and reads headers of its arrays.
+*
+* Only arrays of params->types are returned. Every returned array has data NULL, its size is
+* a size of buffer which receives it and CMF_ArrayAlignment is an alignment of the buffer.
+* With params->dequantize size and format of arrays are the ones after dequantization.
+* Allocator and arena of params are not used.
+*
+* @param filename Name of file, which would be read.
+* @param info Valid pointer to info which would be filled, table of arrays belongs to reader.
+* @param params Load parameters, NULL for defaults.
+* @return Opened reader or NULL if error was occured.
+*/
+struct CMF_Reader* CMF_OpenReader(const char* filename, struct CMF_Info* info, const struct CMF_LoadParams* params)
+{
+	CMF_STATS_SCOPE(CMF_STATS_LOAD, filename);
+	CMF_STATS_TIMER(open_begin);
+
+	struct CMF_Reader* reader = (struct CMF_Reader*)calloc(1, sizeof(struct CMF_Reader));
+	if (reader == NULL) return NULL;
+
+	if (params != NULL) reader->params = *params;
+	else CMF_DefaultLoadParams(&reader->params);
+
+	reader->fp = fopen(filename, "rb");
+	if (reader->fp == NULL) { CMF_CloseReader(reader); return NULL; }
+
+	CMF_Header header;
+
+	if (fread(&header, sizeof(header), 1, reader->fp) != 1 ||
+	    memcmp(header.magic, CMF_MAGIC_STRING, 24) != 0 || header.version != 1)
+	{
+		CMF_CloseReader(reader);
+		return NULL;
+	}
+
+	CMF_STATS_ADD(bytes_read, sizeof(header));
+
+	reader->compression = header.compression;
+	reader->num_vertices = header.num_vertices;
+	reader->arrays = (struct CMF_InfoArray*)calloc(header.num_arrays + 1, sizeof(struct CMF_InfoArray));
+	reader->entries = (struct CMF_TocEntry*)calloc(header.num_arrays + 1, sizeof(struct CMF_TocEntry));
+	reader->compressed = (uint8_t*)calloc(header.num_arrays + 1, 1);
+
+	uint32_t types = reader->params.types;
+	if (reader->params.dequantize && (types & CMF_TYPE_BIT(CMF_TYPE_POSITION))) types |= CMF_TYPE_BIT(CMF_TYPE_BOUNDS);
+
+	if (reader->arrays == NULL || reader->entries == NULL || reader->compressed == NULL ||
+	    CMF_ReaderEntries(reader, &header, types) != 0)
+	{
+		CMF_CloseReader(reader);
+		return NULL;
+	}
+
+	for (uint32_t array = 0; array < reader->num_arrays; array++)
+	{
+		struct CMF_InfoArray* arr = &reader->arrays[array];
+		arr->type = reader->entries[array].type;
+		arr->format = reader->entries[array].format;
+		arr->size = reader->entries[array].size;
+		arr->data = NULL;
+
+		if (!reader->params.dequantize || arr->type > CMF_TYPE_COLOR) continue;
+
+		uint64_t size = CMF_DequantizedSize(arr, reader->num_vertices);
+
+		if (CMF_DequantizedComponents(arr, reader->num_vertices) == 0 || size > UINT32_MAX)
+		{
+			CMF_CloseReader(reader);
+			return NULL;
+		}
+
+		if (size != 0)
+		{
+			arr->format = CMF_FORMAT_FLOAT;
+			arr->size = (uint32_t)size;
+		}
+	}
+
+	info->compression = reader->compression;
+	info->num_vertices = reader->num_vertices;
+	info->num_arrays = reader->num_arrays;
+	info->arrays = reader->arrays;
+
+	CMF_STATS_TIME(open_seconds, open_begin);
+	(void)CMF_STATS_RESULT(0);
+
+	return reader;
+}
+
+/*!
+* @brief Reads arrays into buffers of caller.
+*
+* Raw arrays are read right into buffers, compressed ones are decompressed into them on
+* params->num_threads threads. Only quantized arrays which are dequantized need temporary memory.
+* Reader may read arrays again, for example into next upload buffers.
+*
+* @param reader Opened reader.
+* @param info Info filled by CMF_OpenReader, data of every array is its buffer or NULL to skip it.
+* @return Returns 0 if arrays were read, otherwise returns -1.
+*/
+int CMF_ReaderRead(struct CMF_Reader* reader, const struct CMF_Info* info)
+{
+	CMF_STATS_SCOPE(CMF_STATS_LOAD, NULL);
+
+	uint32_t num_arrays = reader->num_arrays;
+	if (info->num_arrays != num_arrays) return -1;
+
+	// Arrays are decompressed into targets, reads go into targets or into stored data of compressed arrays
+	struct CMF_Info targets = { reader->compression, reader->num_vertices, num_arrays, NULL };
+	struct CMF_Info reads = targets;
+	targets.arrays = (struct CMF_InfoArray*)calloc(num_arrays + 1, sizeof(struct CMF_InfoArray));
+	reads.arrays = (struct CMF_InfoArray*)calloc(num_arrays + 1, sizeof(struct CMF_InfoArray));
+	uint8_t** stored = (uint8_t**)calloc(num_arrays + 1, sizeof(uint8_t*));
+	void** quantized = (void**)calloc(num_arrays + 1, sizeof(void*));
+	uint64_t* offsets = (uint64_t*)calloc(num_arrays + 1, sizeof(uint64_t));
+	float bounds[6];
+
+	int result = (targets.arrays == NULL || reads.arrays == NULL || stored == NULL || quantized == NULL || offsets == NULL) ? -1 : 0;
+
+	for (uint32_t array = 0; array < num_arrays && result == 0; array++)
+	{
+		const struct CMF_TocEntry* entry = &reader->entries[array];
+		void* dst = info->arrays[array].data;
+
+		// Bounds are needed to dequantize positions even if caller skips them
+		if (dst == NULL && reader->params.dequantize && entry->type == CMF_TYPE_BOUNDS && entry->size == sizeof(bounds)) dst = bounds;
+		if (dst == NULL || entry->size == 0) continue;
+
+		// Quantized data is read into temporary memory and converted into buffer of caller
+		if (entry->size != reader->arrays[array].size || entry->format != reader->arrays[array].format)
+		{
+			dst = quantized[array] = CMF_Alloc(NULL, entry->size);
+			if (dst == NULL) { result = -1; break; }
+		}
+
+		targets.arrays[array] = { entry->type, entry->format, entry->stored_size, dst };
+		reads.arrays[array] = targets.arrays[array];
+		offsets[array] = entry->offset;
+
+		CMF_STATS_ADD(bytes_read, entry->stored_size);
+		CMF_STATS_ARRAY(entry->type, entry->format, entry->stored_size, entry->size);
+
+		if (reader->compressed[array])
+		{
+			stored[array] = (uint8_t*)CMF_Alloc(NULL, entry->stored_size);
+			reads.arrays[array].data = stored[array];
+			if (stored[array] == NULL) result = -1;
+		}
+	}
+
+	uint32_t num_threads = CMF_NumThreads(reader->params.num_threads);
+	CMF_STATS_TIMER(io_begin);
+
+	if (result == 0)
+	{
+		struct CMF_ReadJob job;
+		job.fp = reader->fp;
+		job.info = &reads;
+		job.offsets = offsets;
+		job.error = 0;
+
+		CMF_ParallelFor(num_arrays, num_threads, CMF_ReadArrayTask, &job);
+		result = job.error ? -1 : 0;
+	}
+
+	CMF_STATS_TIME(io_seconds, io_begin);
+	CMF_STATS_TIMER(zstd_begin);
+
+	if (result == 0) result = CMF_DecompressArrays(&targets, stored, num_threads, reader->params.context, NULL);
+
+	CMF_STATS_TIME(zstd_seconds, zstd_begin);
+	CMF_STATS_TIMER(repack_begin);
+
+	const float* bounds_data = NULL;
+
+	for (uint32_t array = 0; array < num_arrays && result == 0; array++)
+	{
+		const struct CMF_InfoArray* arr = &targets.arrays[array];
+		if (arr->type == CMF_TYPE_BOUNDS && arr->format == CMF_FORMAT_FLOAT && arr->size == sizeof(bounds) && arr->data != NULL) bounds_data = (const float*)arr->data;
+	}
+
+	for (uint32_t array = 0; array < num_arrays && result == 0; array++)
+	{
+		if (quantized[array] == NULL) continue;
+
+		if (CMF_DequantizeArray(&targets.arrays[array], reader->num_vertices, bounds_data, (float*)info->arrays[array].data) != 0) result = -1;
+	}
+
+	CMF_STATS_TIME(repack_seconds, repack_begin);
+
+	for (uint32_t array = 0; array < num_arrays && stored != NULL && quantized != NULL; array++)
+	{
+		CMF_Free(NULL, stored[array]);
+		CMF_Free(NULL, quantized[array]);
+	}
+
+	free(targets.arrays);
+	free(reads.arrays);
+	free(stored);
+	free(quantized);
+	free(offsets);
+
+	return CMF_STATS_RESULT(result);
+}
+
+/*!
+* @brief Handle of file mapped with CMF_LoadMapped.
+*/
+struct CMF_Mapping
+{
+	void*  address;
+	size_t length;
+};
+
+static int CMF_MapFile(const char* filename, struct CMF_Mapping* mapping)
+{
+	mapping->address = NULL;
+	mapping->length = 0;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) return -1;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) { CloseHandle(file); return -1; }
+
+	HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (map == NULL) return -1;
+
+	void* address = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(map);
+	if (address == NULL) return -1;
+
+	mapping->address = address;
+	mapping->length = (size_t)size.QuadPart;
+#else
+	int fd = open(filename, O_RDONLY);
+	if (fd == -1) return -1;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) { close(fd); return -1; }
+
+	void* address = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (address == MAP_FAILED) return -1;
+
+	madvise(address, st.st_size, MADV_WILLNEED);
+
+	mapping->address = address;
+	mapping->length = st.st_size;
+#endif
+
+	return 0;
+}
+
+static void CMF_UnmapFile(struct CMF_Mapping* mapping)
+{
+	if (mapping->address == NULL) return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(mapping->address);
+#else
+	munmap(mapping->address, mapping->length);
+#endif
+
+	mapping->address = NULL;
+	mapping->length = 0;
+}
+
+/*
+* Fills info with arrays of loaded types of file in memory, data of arrays points to their stored data in base.
+* Array of info is freed if error was occured.
+*/
+static int CMF_ParseArrays(const uint8_t* base, size_t length, struct CMF_Info* info, uint32_t types, const struct CMF_Allocator* allocator)
+{
+	size_t offset = sizeof(struct CMF_Header);
+
+	struct CMF_Header header;
+	if (length < sizeof(header)) return -1;
+	memcpy(&header, base, sizeof(header));
+
+	if (memcmp(header.magic, CMF_MAGIC_STRING, 24) != 0) return -1;
+	if (header.version != 1) return -1;
+
+	info->compression = header.compression;
+	info->num_vertices = header.num_vertices;
+	info->num_arrays = 0;
+	info->arrays = (struct CMF_InfoArray*)CMF_Alloc(allocator, header.num_arrays * sizeof(struct CMF_InfoArray));
+	if (info->arrays == NULL && header.num_arrays != 0) return -1;
+
+	const uint8_t* toc = NULL;
+
+	if (header.flags & CMF_FLAG_TOC)
+	{
+		struct CMF_Toc toc_header;
+		if (length - offset < sizeof(toc_header)) { CMF_Free(allocator, info->arrays); info->arrays = NULL; return -1; }
+		memcpy(&toc_header, base + offset, sizeof(toc_header));
+		offset += sizeof(toc_header);
+
+		if (toc_header.capacity < header.num_arrays || (length - offset) / sizeof(struct CMF_TocEntry) < toc_header.capacity)
+		{
+			CMF_Free(allocator, info->arrays);
+			info->arrays = NULL;
+			return -1;
+		}
+
+		toc = base + offset;
+	}
+
+	for (uint32_t i = 0; i < header.num_arrays; i++)
+	{
+		struct CMF_ArrayHeader arr_header;
+
+		if (toc != NULL)
+		{
+			// Array is found by its offset, headers of arrays are not read
+			struct CMF_TocEntry entry;
+			memcpy(&entry, toc + i * sizeof(entry), sizeof(entry));
+
+			arr_header.type = entry.type;
+			arr_header.format = entry.format;
+			arr_header.size = entry.stored_size;
+			offset = entry.offset > length ? length : (size_t)entry.offset;
+		}
+		else
+		{
+			if (length - offset < sizeof(arr_header)) { CMF_Free(allocator, info->arrays); info->arrays = NULL; return -1; }
+			memcpy(&arr_header, base + offset, sizeof(arr_header));
+			offset += sizeof(arr_header);
+		}
+
+		if (length - offset < arr_header.size) { CMF_Free(allocator, info->arrays); info->arrays = NULL; return -1; }
+
+		if (CMF_IsTypeLoaded(types, arr_header.type))
+		{
+			struct CMF_InfoArray* array = &info->arrays[info->num_arrays++];
+			array->type = arr_header.type;
+			array->format = arr_header.format;
+			array->size = arr_header.size;
+			array->data = (void*)(base + offset);
+		}
+
+		offset += arr_header.size;
+	}
+
+	return 0;
+}
+
+//Compressed arrays cannot be referenced in place, such files must be loaded with CMF_Load2
+static int CMF_HasCompressedArrays(const struct CMF_Info* info)
+{
+	for (uint32_t array = 0; array < info->num_arrays; array++)
+	{
+		if (info->compression == CMF_COMPRESSION_ZSTD && CMF_IsCompressedArray((const uint8_t*)info->arrays[array].data, info->arrays[array].size)) return 1;
+	}
+
+	return 0;
+}
+
+/*!
+* @brief Loads CMF from file without copying array data.
+*
+* File is mapped into memory and data of every array points directly into the mapping,
+* so arrays must not be freed by caller. Use CMF_Unmap to release them.
+* Files with compressed arrays are rejected.
+*
+* @param filename Name of file, which would be mapped.
+* @param info Valid pointer to info which would be filled.
+* @param mapping Valid pointer to mapping handle which keeps data alive.
+* @return Returns 0 if loading was successful, otherwise returns -1.
+*/
+int CMF_LoadMapped(const char* filename, struct CMF_Info* info, struct CMF_Mapping* mapping)
+{
+	if (CMF_MapFile(filename, mapping) != 0) return -1;
+
+	if (CMF_ParseArrays((const uint8_t*)mapping->address, mapping->length, info, CMF_ALL_TYPES, NULL) != 0)
+	{
+		CMF_UnmapFile(mapping);
+		return -1;
+	}
+
+	if (CMF_HasCompressedArrays(info))
+	{
+		free(info->arrays);
+		info->arrays = NULL;
+		CMF_UnmapFile(mapping);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*!
+* @brief Releases info loaded with CMF_LoadMapped.
+*
+* @param info Info which was filled by CMF_LoadMapped, its arrays become invalid.
+* @param mapping Mapping handle which was filled by CMF_LoadMapped.
+*/
+void CMF_Unmap(struct CMF_Info* info, struct CMF_Mapping* mapping)
+{
+	free(info->arrays);
+	info->arrays = NULL;
+	info->num_arrays = 0;
+
+	CMF_UnmapFile(mapping);
+}
+
+/*!
+* @brief File of batch loaded with CMF_LoadAsync.
+*/
+struct CMF_LoadRequest
+{
+	const char* filename; ///< Name of file, which would be read.
+	void* user;           ///< User data of callback.
+	struct CMF_Info info; ///< Filled info, every array must be freed by caller.
+	int result;           ///< 0 if loading was successful, otherwise -1.
+};
+
+/*!
+* @brief Called on worker thread of batch when file is loaded or loading failed.
+*/
+typedef void (*CMF_LoadCallback)(struct CMF_LoadRequest* request);
+
+#define CMF_BATCH_QUEUE_DEPTH 16
+
+/*!
+* @brief Handle of batch started with CMF_LoadAsync.
+*/
+struct CMF_Batch
+{
+	struct CMF_LoadRequest* requests;
+	uint32_t num_requests;
+	struct CMF_LoadParams params;
+	CMF_LoadCallback callback;
+	std::atomic<uint32_t> next;
+	std::atomic<uint32_t> failed;
+	std::thread thread;
+};
+
+/*
+* ZSTD state of batch worker, dictionaries of shared context are used by all workers.
+*/
+struct CMF_BatchWorker
+{
+	struct CMF_Context context;
+	ZSTD_CCtx* cctx;
+	ZSTD_DCtx* dctx;
+};
+
+static void CMF_InitBatchWorker(struct CMF_BatchWorker* worker, const struct CMF_Context* shared)
+{
+	memset(worker, 0, sizeof(struct CMF_BatchWorker));
+	if (shared != NULL) worker->context = *shared;
+
+	worker->context.num_threads = 1;
+	worker->context.cctxs = &worker->cctx;
+	worker->context.dctxs = &worker->dctx;
+}
+
+/*
+* Loads info from file read into memory, compressed arrays are decompressed right from buffer.
+*/
+static int CMF_LoadBuffer(const uint8_t* buffer, size_t length, struct CMF_Info* info, const struct CMF_LoadParams* params,
+                          uint32_t num_threads, struct CMF_Context* context)
+{
+	uint32_t types = params->types;
+	if (params->dequantize && (types & CMF_TYPE_BIT(CMF_TYPE_POSITION))) types |= CMF_TYPE_BIT(CMF_TYPE_BOUNDS);
+
+	if (CMF_ParseArrays(buffer, length, info, types, params->allocator) != 0) return -1;
+
+	return CMF_FinishArrays(info, buffer, length, num_threads, params, context);
+}
+
+static FILE* CMF_OpenBatchFile(const char* filename, uint8_t** buffer, uint64_t* size)
+{
+	FILE* fp = fopen(filename, "rb");
+	if (fp == NULL) return NULL;
+
+#ifdef _WIN32
+	struct _stat64 st;
+	int stat_result = _fstat64(_fileno(fp), &st);
+#else
+	struct stat st;
+	int stat_result = fstat(fileno(fp), &st);
+#endif
+
+	*size = stat_result == 0 ? (uint64_t)st.st_size : 0;
+	*buffer = (*size != 0 && *size == (size_t)*size) ? (uint8_t*)malloc((size_t)*size) : NULL;
+
+	if (*buffer == NULL) { fclose(fp); return NULL; }
+
+	return fp;
+}
+
+static void CMF_FinishRequest(struct CMF_Batch* batch, struct CMF_BatchWorker* worker, uint32_t index, uint8_t* buffer, uint64_t size, int result)
+{
+	struct CMF_LoadRequest* request = &batch->requests[index];
+
+	{
+		// Files are read whole before they are parsed, so only their size is known
+		CMF_STATS_SCOPE(CMF_STATS_LOAD, request->filename);
+		CMF_STATS_ALLOC(buffer, (size_t)size);
+		CMF_STATS_ADD(bytes_read, result == 0 ? size : 0);
+
+		if (result == 0) result = CMF_LoadBuffer(buffer, (size_t)size, &request->info, &batch->params, 1, &worker->context);
+		CMF_Free(NULL, buffer);
+		(void)CMF_STATS_RESULT(result);
+	}
+
+	if (result != 0)
+	{
+		request->info.num_arrays = 0;
+		request->info.arrays = NULL;
+		batch->failed++;
+	}
+
+	request->result = result;
+	if (batch->callback != NULL) batch->callback(request);
+}
+
+#if defined(CMF_IO_URING) && defined(__linux__)
+
+/*
+* Submission and completion queues of io_uring, used through raw system calls.
+*/
+struct CMF_Ring
+{
+	int fd;
+	uint32_t pending;
+	uint32_t *sq_head, *sq_tail, *sq_mask, *sq_array;
+	uint32_t *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe* sqes;
+	struct io_uring_cqe* cqes;
+	void* sq_ring;
+	void* cq_ring;
+	size_t sq_ring_size;
+	size_t cq_ring_size;
+	size_t sqes_size;
+};
+
+static void CMF_FreeRing(struct CMF_Ring* ring)
+{
+	if (ring->sqes != NULL) munmap(ring->sqes, ring->sqes_size);
+	if (ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+	if (ring->sq_ring != NULL) munmap(ring->sq_ring, ring->sq_ring_size);
+	close(ring->fd);
+}
+
+static int CMF_InitRing(struct CMF_Ring* ring, uint32_t entries)
+{
+	memset(ring, 0, sizeof(struct CMF_Ring));
+
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+	if (ring->fd < 0) return -1;
+
+	ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	// Both queues share one mapping on kernels since 5.4
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (ring->cq_ring_size > ring->sq_ring_size) ring->sq_ring_size = ring->cq_ring_size;
+		ring->cq_ring_size = ring->sq_ring_size;
+	}
+
+	void* sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	ring->sq_ring = sq_ring == MAP_FAILED ? NULL : sq_ring;
+	if (ring->sq_ring == NULL) { CMF_FreeRing(ring); return -1; }
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) ring->cq_ring = ring->sq_ring;
+	else
+	{
+		void* cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		ring->cq_ring = cq_ring == MAP_FAILED ? NULL : cq_ring;
+		if (ring->cq_ring == NULL) { CMF_FreeRing(ring); return -1; }
+	}
+
+	void* sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	ring->sqes = sqes == MAP_FAILED ? NULL : (struct io_uring_sqe*)sqes;
+	if (ring->sqes == NULL) { CMF_FreeRing(ring); return -1; }
+
+	uint8_t* sq = (uint8_t*)ring->sq_ring;
+	uint8_t* cq = (uint8_t*)ring->cq_ring;
+
+	ring->sq_head = (uint32_t*)(sq + params.sq_off.head);
+	ring->sq_tail = (uint32_t*)(sq + params.sq_off.tail);
+	ring->sq_mask = (uint32_t*)(sq + params.sq_off.ring_mask);
+	ring->sq_array = (uint32_t*)(sq + params.sq_off.array);
+	ring->cq_head = (uint32_t*)(cq + params.cq_off.head);
+	ring->cq_tail = (uint32_t*)(cq + params.cq_off.tail);
+	ring->cq_mask = (uint32_t*)(cq + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+	return 0;
+}
+
+static void CMF_RingRead(struct CMF_Ring* ring, int fd, void* data, uint64_t size, uint64_t offset, uint64_t user_data)
+{
+	uint32_t tail = *ring->sq_tail;
+	uint32_t index = tail & *ring->sq_mask;
+
+	struct io_uring_sqe* sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t)(uintptr_t)data;
+	sqe->len = size > 0x40000000 ? 0x40000000 : (uint32_t)size;
+	sqe->off = offset;
+	sqe->user_data = user_data;
+
+	ring->sq_array[index] = index;
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	ring->pending++;
+}
+
+// Submits pending reads and waits for at least one completion
+static int CMF_RingSubmit(struct CMF_Ring* ring)
+{
+	for (;;)
+	{
+		int result = (int)syscall(__NR_io_uring_enter, ring->fd, ring->pending, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+
+		if (result >= 0)
+		{
+			ring->pending -= (uint32_t)result;
+			if (ring->pending == 0) return 0;
+		}
+		else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) return -1;
+	}
+}
+
+static int CMF_RingReap(struct CMF_Ring* ring, struct io_uring_cqe* cqe)
+{
+	uint32_t head = *ring->cq_head;
+	if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) return 0;
+
+	*cqe = ring->cqes[head & *ring->cq_mask];
+	__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+	return 1;
+}
+
+// Waits for completions of reads which kernel already took, without submitting new ones
+static int CMF_RingWait(struct CMF_Ring* ring)
+{
+	for (;;)
+	{
+		if (syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) >= 0) return 0;
+		if (errno != EINTR && errno != EAGAIN && errno != EBUSY) return -1;
+	}
+}
+
+#define CMF_RING_FREE     0 ///< Slot has no file
+#define CMF_RING_READING  1 ///< Read of file is in ring
+#define CMF_RING_FALLBACK 2 ///< Rest of file is read without ring
+
+struct CMF_RingFile
+{
+	FILE* fp;
+	uint8_t* buffer;
+	uint64_t size;
+	uint64_t done;
+	uint32_t request;
+	int state;
+};
+
+/*
+* Takes back reads which kernel did not consume after failed submit, so kernel never touches their buffers,
+* their files are read without ring. Returns count of taken back reads.
+*/
+static uint32_t CMF_RingTakeBack(struct CMF_Ring* ring, struct CMF_RingFile* files)
+{
+	uint32_t head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	uint32_t tail = *ring->sq_tail;
+
+	for (uint32_t i = head; i != tail; i++)
+	{
+		files[ring->sqes[ring->sq_array[i & *ring->sq_mask]].user_data].state = CMF_RING_FALLBACK;
+	}
+
+	__atomic_store_n(ring->sq_tail, head, __ATOMIC_RELEASE);
+	ring->pending = 0;
+
+	return tail - head;
+}
+
+/*
+* Keeps up to CMF_BATCH_QUEUE_DEPTH whole file reads in flight and decodes files as soon as they are read.
+* Stops without taking any request if io_uring is not available. If submit fails, no more requests are taken,
+* reads which kernel took are waited for, so their buffers are never freed under them, and the rest of files
+* is read without ring. Requests which are not taken are read by the positioned reads of CMF_BatchTask.
+*/
+static void CMF_BatchRingLoop(struct CMF_Batch* batch, struct CMF_BatchWorker* worker)
+{
+	struct CMF_Ring ring;
+	if (CMF_InitRing(&ring, CMF_BATCH_QUEUE_DEPTH) != 0) return;
+
+	struct CMF_RingFile files[CMF_BATCH_QUEUE_DEPTH];
+	uint32_t free_slots[CMF_BATCH_QUEUE_DEPTH];
+	uint32_t num_free = CMF_BATCH_QUEUE_DEPTH;
+	uint32_t in_flight = 0;
+	int exhausted = 0;
+	int failed = 0;
+
+	for (uint32_t slot = 0; slot < CMF_BATCH_QUEUE_DEPTH; slot++)
+	{
+		free_slots[slot] = slot;
+		files[slot].state = CMF_RING_FREE;
+	}
+
+	for (;;)
+	{
+		while (num_free > 0 && !exhausted && !failed)
+		{
+			uint32_t index = batch->next++;
+			if (index >= batch->num_requests) { exhausted = 1; break; }
+
+			uint32_t slot = free_slots[num_free - 1];
+			struct CMF_RingFile* file = &files[slot];
+
+			file->fp = CMF_OpenBatchFile(batch->requests[index].filename, &file->buffer, &file->size);
+			file->done = 0;
+			file->request = index;
+
+			if (file->fp == NULL) { CMF_FinishRequest(batch, worker, index, NULL, 0, -1); continue; }
+
+			CMF_RingRead(&ring, fileno(file->fp), file->buffer, file->size, 0, slot);
+			file->state = CMF_RING_READING;
+			num_free--;
+			in_flight++;
+		}
+
+		if (in_flight == 0) break;
+
+		if (!failed && CMF_RingSubmit(&ring) != 0)
+		{
+			failed = 1;
+			in_flight -= CMF_RingTakeBack(&ring, files);
+			continue;
+		}
+
+		if (failed && CMF_RingWait(&ring) != 0) break;
+
+		struct io_uring_cqe cqe;
+
+		while (CMF_RingReap(&ring, &cqe))
+		{
+			uint32_t slot = (uint32_t)cqe.user_data;
+			struct CMF_RingFile* file = &files[slot];
+
+			if (cqe.res > 0) file->done += (uint64_t)cqe.res;
+
+			if (cqe.res > 0 && file->done < file->size && !failed)
+			{
+				// Short read, the rest is requested again
+				CMF_RingRead(&ring, fileno(file->fp), file->buffer + file->done, file->size - file->done, file->done, slot);
+				continue;
+			}
+
+			if (cqe.res > 0 && file->done < file->size)
+			{
+				// Ring can't take new reads after failure, the rest is read without it
+				file->state = CMF_RING_FALLBACK;
+				in_flight--;
+				continue;
+			}
+
+			fclose(file->fp);
+			file->state = CMF_RING_FREE;
+			free_slots[num_free++] = slot;
+			in_flight--;
+
+			CMF_FinishRequest(batch, worker, file->request, file->buffer, file->size, file->done == file->size ? 0 : -1);
+		}
+	}
+
+	CMF_FreeRing(&ring);
+
+	for (uint32_t slot = 0; slot < CMF_BATCH_QUEUE_DEPTH; slot++)
+	{
+		struct CMF_RingFile* file = &files[slot];
+
+		if (file->state == CMF_RING_FALLBACK)
+		{
+			int result = CMF_ReadAt(file->fp, file->buffer + file->done, (size_t)(file->size - file->done), file->done);
+			fclose(file->fp);
+			CMF_FinishRequest(batch, worker, file->request, file->buffer, file->size, result);
+		}
+		else if (file->state == CMF_RING_READING)
+		{
+			// Completion could not be waited for, so kernel may still write into buffer, it is leaked on purpose
+			CMF_FinishRequest(batch, worker, file->request, NULL, 0, -1);
+		}
+	}
+}
+
+#endif
+
+static void CMF_BatchTask(void* user, uint32_t task, uint32_t thread)
+{
+	struct CMF_Batch* batch = (struct CMF_Batch*)user;
+	struct CMF_BatchWorker worker;
+	CMF_InitBatchWorker(&worker, batch->params.context);
+	(void)task;
+	(void)thread;
+
+#if defined(CMF_IO_URING) && defined(__linux__)
+	CMF_BatchRingLoop(batch, &worker);
+#endif
+
+	// Fallback keeps one positioned read in flight on every worker, it takes requests left by the ring
+	for (uint32_t index = batch->next++; index < batch->num_requests; index = batch->next++)
+	{
+		uint8_t* buffer = NULL;
+		uint64_t size = 0;
+
+		FILE* fp = CMF_OpenBatchFile(batch->requests[index].filename, &buffer, &size);
+		int result = fp != NULL ? CMF_ReadAt(fp, buffer, (size_t)size, 0) : -1;
+		if (fp != NULL) fclose(fp);
+
+		CMF_FinishRequest(batch, &worker, index, buffer, size, result);
+	}
+
+	ZSTD_freeDCtx(worker.dctx);
+}
+
+/*!
+* @brief Starts loading of batch of files in background.
+*
+* Files are loaded on params->num_threads worker threads. With CMF_IO_URING defined on Linux every worker
+* keeps CMF_BATCH_QUEUE_DEPTH reads in flight with io_uring, otherwise every worker reads one file at once with pread.
+* Every file is read whole, params->types only limits arrays which are decoded.
+* Callback is called on worker thread for every request once its info and result are filled.
+*
+* @param requests Files to load, they must be valid until CMF_WaitBatch returns.
+* @param num_requests Count of requests.
+* @param params Load parameters, NULL for defaults. Dictionaries of params->context are shared by workers.
+* @param callback Function called for every loaded file, may be NULL.
+* @return Handle of batch, which must be passed to CMF_WaitBatch, or NULL if error was occured.
+*/
+struct CMF_Batch* CMF_LoadAsync(struct CMF_LoadRequest* requests, uint32_t num_requests, const struct CMF_LoadParams* params, CMF_LoadCallback callback)
+{
+	struct CMF_Batch* batch = new (std::nothrow) CMF_Batch();
+	if (batch == NULL) return NULL;
+
+	batch->requests = requests;
+	batch->num_requests = num_requests;
+	batch->callback = callback;
+	batch->next = 0;
+	batch->failed = 0;
+
+	if (params != NULL) batch->params = *params;
+	else CMF_DefaultLoadParams(&batch->params);
+
+	for (uint32_t i = 0; i < num_requests; i++)
+	{
+		requests[i].info.num_arrays = 0;
+		requests[i].info.arrays = NULL;
+		requests[i].result = -1;
+	}
+
+	uint32_t num_workers = CMF_NumThreads(batch->params.num_threads);
+	if (num_workers > num_requests) num_workers = num_requests;
+
+	batch->thread = std::thread([batch, num_workers]() { CMF_ParallelFor(num_workers, num_workers, CMF_BatchTask, batch); });
+
+	return batch;
+}
+
+/*!
+* @brief Waits until every file of batch is loaded and frees batch.
+*
+* @return Returns 0 if every file was loaded successfully, otherwise returns -1.
+*/
+int CMF_WaitBatch(struct CMF_Batch* batch)
+{
+	batch->thread.join();
+
+	int result = batch->failed == 0 ? 0 : -1;
+	delete batch;
+
+	return result;
+}
+
+/*!
+* @brief Loads batch of files and waits for them, see CMF_LoadAsync.
+*/
+int CMF_LoadBatch(struct CMF_LoadRequest* requests, uint32_t num_requests, const struct CMF_LoadParams* params, CMF_LoadCallback callback)
+{
+	struct CMF_Batch* batch = CMF_LoadAsync(requests, num_requests, params, callback);
+	return batch != NULL ? CMF_WaitBatch(batch) : -1;
+}
+
+/*!
+* @brief Returns 64-bit FNV-1a hash of name, which is a key of entry of pack.
+*/
+uint64_t CMF_HashName(const char* name, size_t size)
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= (uint8_t)name[i];
+		hash *= 0x100000001B3ull;
+	}
+
+	return hash;
+}
+
+static uint32_t CMF_PackBucket(uint64_t hash, uint32_t bucket_bits)
+{
+	return bucket_bits == 0 ? 0 : (uint32_t)(hash >> (64 - bucket_bits));
+}
+
+static int CMF_ComparePackEntries(const void* a, const void* b)
+{
+	const struct CMF_PackEntry* left = (const struct CMF_PackEntry*)a;
+	const struct CMF_PackEntry* right = (const struct CMF_PackEntry*)b;
+
+	if (left->hash != right->hash) return left->hash < right->hash ? -1 : 1;
+	return left->offset < right->offset ? -1 : left->offset > right->offset;
+}
+
+/*!
+* @brief File written into pack by CMF_SavePack.
+*/
+struct CMF_PackFile
+{
+	const char* name; ///< Name of file in pack, which is looked up by CMF_FindInPack.
+	const char* path; ///< Path of file, which would be read.
+};
+
+/*!
+* @brief Checks if name of file in pack is relative path, which stays inside directory it is unpacked into.
+*
+* Name must not be empty, must not start with slash or drive letter and must not have ".." components.
+* Pack is untrusted input, so names read from pack must be checked before they are used as paths.
+*
+* @return Returns 1 if name is safe, otherwise returns 0.
+*/
+int CMF_IsSafePackName(const char* name)
+{
+	if (name == NULL || name[0] == '\0' || name[0] == '/' || name[0] == '\\') return 0;
+	if (((name[0] >= 'A' && name[0] <= 'Z') || (name[0] >= 'a' && name[0] <= 'z')) && name[1] == ':') return 0;
+
+	for (const char* part = name; *part != '\0';)
+	{
+		size_t size = strcspn(part, "/\\");
+		if (size == 2 && part[0] == '.' && part[1] == '.') return 0;
+
+		part += size;
+		if (*part != '\0') part++;
+	}
+
+	return 1;
+}
+
+/*!
+* @brief Writes files into pack.
+*
+* Files are copied by chunks in order of files, so they are never in memory at once.
+* Index is written after files, when their offsets are known.
+*
+* @param filename Name of pack, which would be written.
+* @param files Names and paths of files, names must be unique and safe for CMF_IsSafePackName.
+* @param num_files Count of files.
+* @return Returns 0 if pack was written, otherwise returns -1.
+*/
+int CMF_SavePack(const char* filename, const struct CMF_PackFile* files, uint32_t num_files)
+{
+	struct CMF_PackHeader header;
+	memcpy(header.magic, CMF_PACK_MAGIC_STRING, 24);
+	header.version = 1;
+	header.num_entries = num_files;
+	header.bucket_bits = 0;
+	header.reserved = 0;
+	header.names_size = 0;
+
+	while (header.bucket_bits < 31 && (1u << header.bucket_bits) < num_files) header.bucket_bits++;
+
+	uint32_t num_buckets = 1u << header.bucket_bits;
+	struct CMF_PackEntry* entries = (struct CMF_PackEntry*)calloc(num_files + 1, sizeof(struct CMF_PackEntry));
+	uint32_t* buckets = (uint32_t*)calloc(num_buckets + 1, sizeof(uint32_t));
+	uint32_t* slots = (uint32_t*)calloc(num_files + 1, sizeof(uint32_t));
+	uint8_t* chunk = (uint8_t*)malloc(CMF_DEFAULT_BLOCK_SIZE);
+	char* names = NULL;
+
+	int result = (entries == NULL || buckets == NULL || slots == NULL || chunk == NULL) ? -1 : 0;
+
+	for (uint32_t file = 0; file < num_files && result == 0; file++)
+	{
+		if (!CMF_IsSafePackName(files[file].name)) { result = -1; break; }
+
+		size_t size = strlen(files[file].name);
+		if (size > UINT32_MAX - header.names_size - 1) { result = -1; break; }
+
+		// Offset keeps index of file until entries are sorted
+		entries[file].hash = CMF_HashName(files[file].name, size);
+		entries[file].offset = file;
+		entries[file].name_offset = (uint32_t)header.names_size;
+		entries[file].name_size = (uint32_t)size;
+		header.names_size += size + 1;
+	}
+
+	if (result == 0 && (names = (char*)malloc(header.names_size + 1)) == NULL) result = -1;
+
+	for (uint32_t file = 0; file < num_files && result == 0; file++)
+	{
+		memcpy(names + entries[file].name_offset, files[file].name, entries[file].name_size + 1);
+	}
+
+	if (result == 0)
+	{
+		qsort(entries, num_files, sizeof(struct CMF_PackEntry), CMF_ComparePackEntries);
+
+		for (uint32_t entry = 0; entry < num_files; entry++)
+		{
+			const struct CMF_PackEntry* current = &entries[entry];
+			slots[current->offset] = entry;
+
+			// Equal names have equal hashes, so only following entries of the same hash are compared
+			for (uint32_t next = entry + 1; next < num_files && entries[next].hash == current->hash; next++)
+			{
+				if (entries[next].name_size == current->name_size &&
+				    memcmp(names + entries[next].name_offset, names + current->name_offset, current->name_size) == 0)
+				{
+					result = -1;
+				}
+			}
+		}
+
+		for (uint32_t bucket = 0, entry = 0; bucket <= num_buckets; bucket++)
+		{
+			while (entry < num_files && CMF_PackBucket(entries[entry].hash, header.bucket_bits) < bucket) entry++;
+			buckets[bucket] = entry;
+		}
+	}
+
+	header.names_offset = sizeof(header) + (uint64_t)num_files * sizeof(struct CMF_PackEntry) + (num_buckets + 1) * sizeof(uint32_t);
+
+	FILE* fp = result == 0 ? fopen(filename, "wb") : NULL;
+	if (fp == NULL) result = -1;
+
+	uint64_t offset = header.names_offset + header.names_size;
+	uint8_t padding[CMF_PACK_ALIGNMENT] = { 0 };
+
+	// Index is reserved and written when offsets of files are known
+	if (result == 0 && CMF_FSEEK(fp, offset, SEEK_SET) != 0) result = -1;
+
+	for (uint32_t file = 0; file < num_files && result == 0; file++)
+	{
+		size_t pad = (size_t)((CMF_PACK_ALIGNMENT - offset % CMF_PACK_ALIGNMENT) % CMF_PACK_ALIGNMENT);
+		if (pad != 0 && fwrite(padding, pad, 1, fp) != 1) { result = -1; break; }
+		offset += pad;
+
+		FILE* input = fopen(files[file].path, "rb");
+		if (input == NULL) { result = -1; break; }
+
+		struct CMF_PackEntry* entry = &entries[slots[file]];
+		entry->offset = offset;
+		entry->size = 0;
+
+		size_t count;
+		while ((count = fread(chunk, 1, CMF_DEFAULT_BLOCK_SIZE, input)) != 0)
+		{
+			if (fwrite(chunk, count, 1, fp) != 1) { result = -1; break; }
+			entry->size += count;
+		}
+
+		if (ferror(input)) result = -1;
+		fclose(input);
+
+		offset += entry->size;
+	}
+
+	if (result == 0)
+	{
+		if (CMF_FSEEK(fp, 0, SEEK_SET) != 0 ||
+		    fwrite(&header, sizeof(header), 1, fp) != 1 ||
+		    (num_files != 0 && fwrite(entries, sizeof(struct CMF_PackEntry), num_files, fp) != num_files) ||
+		    fwrite(buckets, sizeof(uint32_t), num_buckets + 1, fp) != num_buckets + 1 ||
+		    (header.names_size != 0 && fwrite(names, header.names_size, 1, fp) != 1))
+		{
+			result = -1;
+		}
+	}
+
+	if (fp != NULL && fclose(fp) != 0) result = -1;
+
+	free(entries);
+	free(buckets);
+	free(slots);
+	free(chunk);
+	free(names);
+
+	return result;
+}
+
+/*!
+* @brief Pack opened with CMF_OpenPack, it is mapped into memory.
+*/
+struct CMF_Pack
+{
+	struct CMF_Mapping mapping;
+	struct CMF_PackHeader header;
+	const struct CMF_PackEntry* entries;
+	const uint32_t* buckets;
+	const char* names;
+};
+
+/*!
+* @brief Maps pack into memory and checks its index.
+*
+* @param filename Name of pack, which would be mapped.
+* @param pack Valid pointer to pack which would be filled.
+* @return Returns 0 if pack was opened, otherwise returns -1.
+*/
+int CMF_OpenPack(const char* filename, struct CMF_Pack* pack)
+{
+	if (CMF_MapFile(filename, &pack->mapping) != 0) return -1;
+
+	const uint8_t* base = (const uint8_t*)pack->mapping.address;
+	uint64_t length = pack->mapping.length;
+
+	if (length < sizeof(pack->header)) { CMF_UnmapFile(&pack->mapping); return -1; }
+	memcpy(&pack->header, base, sizeof(pack->header));
+
+	const struct CMF_PackHeader* header = &pack->header;
+	uint64_t index_size = (uint64_t)header->num_entries * sizeof(struct CMF_PackEntry);
+	uint64_t buckets_size = header->bucket_bits < 32 ? ((1ull << header->bucket_bits) + 1) * sizeof(uint32_t) : 0;
+
+	if (memcmp(header->magic, CMF_PACK_MAGIC_STRING, 24) != 0 || header->version != 1 || buckets_size == 0 ||
+	    header->names_offset != sizeof(*header) + index_size + buckets_size ||
+	    header->names_size > length || header->names_offset > length - header->names_size)
+	{
+		CMF_UnmapFile(&pack->mapping);
+		return -1;
+	}
+
+	pack->entries = (const struct CMF_PackEntry*)(base + sizeof(*header));
+	pack->buckets = (const uint32_t*)(base + sizeof(*header) + index_size);
+	pack->names = (const char*)(base + header->names_offset);
+
+	return 0;
+}
+
+/*!
+* @brief Unmaps pack, data of its files becomes invalid.
+*/
+void CMF_ClosePack(struct CMF_Pack* pack)
+{
+	CMF_UnmapFile(&pack->mapping);
+}
+
+/*!
+* @brief Looks file up by its name, only entries of one bucket of hash are compared.
+*
+* @param pack Opened pack.
+* @param name Name of file in pack.
+* @param index Valid pointer to index of entry, which would be filled.
+* @return Returns 0 if file was found, otherwise returns -1.
+*/
+int CMF_FindInPack(const struct CMF_Pack* pack, const char* name, uint32_t* index)
+{
+	size_t size = strlen(name);
+	uint64_t hash = CMF_HashName(name, size);
+	uint32_t bucket = CMF_PackBucket(hash, pack->header.bucket_bits);
+	uint32_t end = pack->buckets[bucket + 1] < pack->header.num_entries ? pack->buckets[bucket + 1] : pack->header.num_entries;
+
+	for (uint32_t i = pack->buckets[bucket]; i < end; i++)
+	{
+		const struct CMF_PackEntry* entry = &pack->entries[i];
+		if (entry->hash != hash || entry->name_size != size) continue;
+		if ((uint64_t)entry->name_offset + size >= pack->header.names_size) continue;
+
+		if (memcmp(pack->names + entry->name_offset, name, size) == 0)
+		{
+			*index = i;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+/*!
+* @brief Returns name of file of entry with terminating zero or NULL if entry is invalid.
+*/
+const char* CMF_PackFileName(const struct CMF_Pack* pack, uint32_t index)
+{
+	if (index >= pack->header.num_entries) return NULL;
+
+	const struct CMF_PackEntry* entry = &pack->entries[index];
+	if ((uint64_t)entry->name_offset + entry->name_size >= pack->header.names_size) return NULL;
+
+	const char* name = pack->names + entry->name_offset;
+	return name[entry->name_size] == '\0' ? name : NULL;
+}
+
+/*!
+* @brief Returns data of file of entry inside of mapping or NULL if entry is invalid.
+*
+* @param size Valid pointer to size of file, which would be filled.
+*/
+const void* CMF_PackFileData(const struct CMF_Pack* pack, uint32_t index, uint64_t* size)
+{
+	if (index >= pack->header.num_entries) return NULL;
+
+	const struct CMF_PackEntry* entry = &pack->entries[index];
+	if (entry->size > pack->mapping.length || entry->offset > pack->mapping.length - entry->size) return NULL;
+
+	*size = entry->size;
+	return (const uint8_t*)pack->mapping.address + entry->offset;
+}
+
+/*!
+* @brief Loads CMF from pack without copying array data.
+*
+* Data of every array points directly into mapping of pack, so arrays are valid until pack is closed.
+* Files with compressed arrays are rejected, they must be loaded with CMF_LoadFromPackEx.
+*
+* @param pack Opened pack.
+* @param name Name of file in pack.
+* @param info Valid pointer to info which would be filled, release it with CMF_UnloadFromPack.
+* @return Returns 0 if loading was successful, otherwise returns -1.
+*/
+int CMF_LoadFromPack(const struct CMF_Pack* pack, const char* name, struct CMF_Info* info)
+{
+	uint32_t index;
+	uint64_t size = 0;
+	if (CMF_FindInPack(pack, name, &index) != 0) return -1;
+
+	const uint8_t* data = (const uint8_t*)CMF_PackFileData(pack, index, &size);
+	if (data == NULL || CMF_ParseArrays(data, (size_t)size, info, CMF_ALL_TYPES, NULL) != 0) return -1;
+
+	if (CMF_HasCompressedArrays(info))
+	{
+		free(info->arrays);
+		info->arrays = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*!
+* @brief Releases info loaded with CMF_LoadFromPack, its arrays become invalid.
+*/
+void CMF_UnloadFromPack(struct CMF_Info* info)
+{
+	free(info->arrays);
+	info->arrays = NULL;
+	info->num_arrays = 0;
+}
+
+/*!
+* @brief Loads CMF from pack as CMF_Load2Ex does, arrays are copied out of mapping.
+*
+* @param pack Opened pack.
+* @param name Name of file in pack.
+* @param info Valid pointer to info which would be filled, release it with CMF_FreeInfo.
+* @param params Load parameters, NULL for defaults.
+* @return Returns 0 if loading was successful, otherwise returns -1.
+*/
+int CMF_LoadFromPackEx(const struct CMF_Pack* pack, const char* name, struct CMF_Info* info, const struct CMF_LoadParams* params)
+{
+	struct CMF_LoadParams defaults;
+	if (params == NULL) { CMF_DefaultLoadParams(&defaults); params = &defaults; }
+
+	uint32_t index;
+	uint64_t size = 0;
+	if (CMF_FindInPack(pack, name, &index) != 0) return -1;
+
+	CMF_STATS_SCOPE(CMF_STATS_LOAD, name);
+
+	const uint8_t* data = (const uint8_t*)CMF_PackFileData(pack, index, &size);
+	if (data == NULL) return -1;
+	CMF_STATS_ADD(bytes_read, size);
+
+	return CMF_STATS_RESULT(CMF_LoadBuffer(data, (size_t)size, info, params, CMF_NumThreads(params->num_threads), params->context));
+}
+
+// Writes data and remembers failure, so the whole file is checked at once
+static void CMF_WriteChecked(FILE* fp, const void* data, size_t size, int* error)
+{
+	if (size != 0 && fwrite(data, size, 1, fp) != 1) *error = 1;
+}
+
+/*!
+* @brief Saves info to CMF file of version 1.
+*
+* If info->compression is CMF_COMPRESSION_ZSTD, every array is split into blocks of params->block_size bytes,
+* which are compressed into independent ZSTD frames on params->num_threads threads.
+* If any write fails, the partial file is removed, unless filename is not a regular file.
+*
+* @param filename Name of file in which would be written arrays.
+* @param info Valid pointer to info which would be written.
+* @param params Save parameters, NULL for defaults.
+* @return Returns 0 if saving was successful, otherwise returns -1.
+*/
+int CMF_Save2Ex(const char* filename, struct CMF_Info* info, const struct CMF_SaveParams* params)
+{
+	struct CMF_SaveParams defaults;
+	if (params == NULL) { CMF_DefaultSaveParams(&defaults); params = &defaults; }
+
+	CMF_STATS_SCOPE(CMF_STATS_SAVE, filename);
+
+	uint32_t block_size = params->block_size != 0 ? params->block_size : CMF_DEFAULT_BLOCK_SIZE;
+	uint32_t num_threads = CMF_NumThreads(params->num_threads);
+
+	struct CMF_BlockJob job;
+	memset(&job, 0, sizeof(job));
+
+	uint8_t* compressed = NULL;
+	uint32_t num_blocks = 0;
+
+	CMF_STATS_TIMER(zstd_begin);
+
+	if (info->compression == CMF_COMPRESSION_ZSTD)
+	{
+		size_t capacity = 0;
+
+		for (uint32_t array = 0; array < info->num_arrays; array++)
+		{
+			capacity += CMF_BlocksBound(info->arrays[array].size, block_size);
+			num_blocks += CMF_CountBlocks(info->arrays[array].size, block_size);
+		}
+
+		if (CMF_InitBlockJob(&job, num_blocks, num_threads, params->context, params->level) != 0) return -1;
+
+		compressed = (uint8_t*)CMF_Alloc(NULL, capacity);
+		if (compressed == NULL) { CMF_FreeBlockJob(&job); return -1; }
+
+		uint32_t block = 0;
+		uint8_t* dst = compressed;
+
+		for (uint32_t array = 0; array < info->num_arrays; array++)
+		{
+			const ZSTD_CDict* cdict = CMF_FindTypeDictionary(params->context, info->arrays[array].type);
+			dst = CMF_FillBlocks(job.blocks + block, (const uint8_t*)info->arrays[array].data, info->arrays[array].size, block_size, dst, cdict);
+			block += CMF_CountBlocks(info->arrays[array].size, block_size);
+		}
+
+		if (CMF_RunBlockJob(&job, num_blocks, CMF_CompressBlock) != 0)
+		{
+			CMF_FreeBlockJob(&job);
+			CMF_Free(NULL, compressed);
+			return -1;
+		}
+	}
+
+	CMF_STATS_TIME(zstd_seconds, zstd_begin);
+	CMF_STATS_TIMER(open_begin);
+
+	uint32_t* stored_sizes = (uint32_t*)malloc(info->num_arrays * sizeof(uint32_t));
+	uint32_t block = 0;
+
+	if (stored_sizes == NULL && info->num_arrays != 0)
+	{
+		CMF_FreeBlockJob(&job);
+		CMF_Free(NULL, compressed);
+		return -1;
+	}
+
+	CMF_Header header;
+	memcpy(&header.magic, CMF_MAGIC_STRING, 24);
+	header.version = 1;
+	header.filesize = 0;
+	header.flags = 0;
+	header.compression = info->compression;
+	header.num_vertices = info->num_vertices;
+	header.num_arrays = info->num_arrays;
+
+	uint64_t filesize = sizeof(header);
+
+	if (params->toc != 0)
+	{
+		header.flags |= CMF_FLAG_TOC;
+		filesize += sizeof(struct CMF_Toc) + (uint64_t)info->num_arrays * sizeof(struct CMF_TocEntry);
+	}
+
+	for (uint32_t array = 0; array < info->num_arrays; array++)
+	{
+		if (CMF_TYPE_LEVEL(info->arrays[array].type) > 0) header.flags |= CMF_FLAG_LODS;
+
+		stored_sizes[array] = info->arrays[array].size;
+
+		if (info->compression == CMF_COMPRESSION_ZSTD)
+		{
+			uint32_t count = CMF_CountBlocks(info->arrays[array].size, block_size);
+			stored_sizes[array] = sizeof(uint32_t);
+
+			for (uint32_t i = 0; i < count; i++, block++) stored_sizes[array] += job.blocks[block].dst_size;
+		}
+
+		filesize += sizeof(struct CMF_ArrayHeader) + stored_sizes[array];
+	}
+
+	// As in CMF_CloseWriter, size which does not fit into header is written as 0
+	header.filesize = filesize > UINT32_MAX ? 0 : (uint32_t)filesize;
+
+	FILE* fp = fopen(filename, "wb");
+	if (fp == NULL) { CMF_FreeBlockJob(&job); CMF_Free(NULL, compressed); free(stored_sizes); return -1; }
+
+	// Only regular file is removed after failure, never device or pipe
+#ifdef _WIN32
+	struct _stat64 st;
+	int regular = _fstat64(_fileno(fp), &st) == 0 && (st.st_mode & _S_IFREG) != 0;
+#else
+	struct stat st;
+	int regular = fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode);
+#endif
+
+	int error = 0;
+
+	CMF_WriteChecked(fp, &header, sizeof(header), &error);
+	if (!error) CMF_STATS_ADD(bytes_written, sizeof(header));
+
+	if (params->toc != 0)
+	{
+		struct CMF_Toc toc = { info->num_arrays, 0 };
+		uint64_t offset = sizeof(header) + sizeof(toc) + (uint64_t)info->num_arrays * sizeof(struct CMF_TocEntry);
+
+		CMF_WriteChecked(fp, &toc, sizeof(toc), &error);
+
+		for (uint32_t array = 0; array < info->num_arrays; array++)
+		{
+			offset += sizeof(struct CMF_ArrayHeader);
+
+			struct CMF_TocEntry entry = { info->arrays[array].type, info->arrays[array].format, offset, info->arrays[array].size, stored_sizes[array] };
+			CMF_WriteChecked(fp, &entry, sizeof(entry), &error);
+
+			offset += stored_sizes[array];
+		}
+
+		if (!error) CMF_STATS_ADD(bytes_written, sizeof(toc) + info->num_arrays * sizeof(struct CMF_TocEntry));
+	}
+
+	CMF_STATS_TIME(open_seconds, open_begin);
+	CMF_STATS_TIMER(io_begin);
+
+	block = 0;
+
+	for (uint32_t array = 0; array < info->num_arrays && !error; array++)
+	{
+		if (info->compression == CMF_COMPRESSION_ZSTD)
+		{
+			uint32_t count = CMF_CountBlocks(info->arrays[array].size, block_size);
+
+			CMF_WriteChecked(fp, &info->arrays[array].type, sizeof(info->arrays[array].type), &error);
+			CMF_WriteChecked(fp, &info->arrays[array].format, sizeof(info->arrays[array].format), &error);
+			CMF_WriteChecked(fp, &stored_sizes[array], sizeof(stored_sizes[array]), &error);
+			CMF_WriteChecked(fp, &info->arrays[array].size, sizeof(info->arrays[array].size), &error);
+
+			for (uint32_t i = 0; i < count; i++, block++) CMF_WriteChecked(fp, job.blocks[block].dst, job.blocks[block].dst_size, &error);
+		}
+		else
+		{
+			CMF_WriteChecked(fp, &info->arrays[array].type, sizeof(info->arrays[array].type), &error);
+			CMF_WriteChecked(fp, &info->arrays[array].format, sizeof(info->arrays[array].format), &error);
+			CMF_WriteChecked(fp, &info->arrays[array].size, sizeof(info->arrays[array].size), &error);
+			CMF_WriteChecked(fp, info->arrays[array].data, info->arrays[array].size, &error);
+		}
+
+		if (!error) CMF_STATS_ADD(bytes_written, sizeof(struct CMF_ArrayHeader) + stored_sizes[array]);
+		CMF_STATS_ARRAY(info->arrays[array].type, info->arrays[array].format, stored_sizes[array], info->arrays[array].size);
+	}
+
+	// Buffered data is written by fclose, so its result is a part of the check
+	if (fclose(fp) != 0) error = 1;
+	CMF_STATS_TIME(io_seconds, io_begin);
+
+	CMF_FreeBlockJob(&job);
+	CMF_Free(NULL, compressed);
+	free(stored_sizes);
+
+	// Partial file is not left to be mistaken for a saved one
+	if (error && regular) remove(filename);
+
+	return CMF_STATS_RESULT(error ? -1 : 0);
+}
+
+int CMF_Save2Level(const char* filename, struct CMF_Info* info, int level)
+{
+	struct CMF_SaveParams params;
+	CMF_DefaultSaveParams(&params);
+	params.level = level;
+
+	return CMF_Save2Ex(filename, info, &params);
+}
+
+int CMF_Save2(const char* filename, struct CMF_Info* info)
+{
+	return CMF_Save2Ex(filename, info, NULL);
+}
+
+/*!
+* @brief Incremental writer of CMF file of version 1.
+*
+* Arrays are written one after another, data of current array is appended by chunks,
+* so the whole model never has to be in memory. With CMF_COMPRESSION_ZSTD every chunk
+* is compressed into its own frames right away. Sizes in headers are patched when array
+* is ended and when writer is closed. After any failure the next calls fail too and
+* CMF_CloseWriter returns -1, so a truncated file is not reported as written.
+*/
+struct CMF_Writer
+{
+	FILE* fp;
+	struct CMF_Header header;
+	struct CMF_ArrayHeader array_header;
+	struct CMF_SaveParams params;
+	struct CMF_Context* own_context;
+	uint64_t offset;
+	uint64_t array_offset;
+	uint32_t array_size;
+	int array_open;
+	int error;
+	uint8_t* buffer;
+	size_t buffer_size;
+	struct CMF_TocEntry* toc;
+};
+
+static int CMF_WriterWrite(struct CMF_Writer* writer, const void* data, size_t size)
+{
+	if (size != 0 && fwrite(data, size, 1, writer->fp) != 1) writer->error = 1;
+	writer->offset += size;
+	return writer->error ? -1 : 0;
+}
 
-enum CMF_Compression
+static int CMF_WriterPatch(struct CMF_Writer* writer, uint64_t offset, const void* data, size_t size)
 {
-	CMF_COMPRESSION_NONE = 1 << 0,
-	CMF_COMPRESSION_ZSTD = 1 << 1
-};
+	if (CMF_FSEEK(writer->fp, offset, SEEK_SET) != 0 ||
+	    fwrite(data, size, 1, writer->fp) != 1 ||
+	    CMF_FSEEK(writer->fp, writer->offset, SEEK_SET) != 0)
+	{
+		writer->error = 1;
+	}
 
-enum CMF_Type
+	return writer->error ? -1 : 0;
+}
+
+/*!
+* @brief Opens writer of CMF file.
+*
+* @param filename Name of file in which would be written arrays.
+* @param compression CMF_COMPRESSION_NONE or CMF_COMPRESSION_ZSTD.
+* @param params Save parameters, NULL for defaults.
+* @return Opened writer or NULL if error was occured.
+*/
+struct CMF_Writer* CMF_OpenWriter(const char* filename, uint32_t compression, const struct CMF_SaveParams* params)
 {
-	CMF_TYPE_POSITION = 0,
-	CMF_TYPE_TEXCOORD = 1,
-	CMF_TYPE_NORMAL   = 2,
-	CMF_TYPE_TANGENT  = 3,
-	CMF_TYPE_COLOR    = 4,
-	CMF_TYPE_INDICES  = 5
-};
+	struct CMF_Writer* writer = (struct CMF_Writer*)calloc(1, sizeof(struct CMF_Writer));
+	if (writer == NULL) return NULL;
 
-enum CMF_Format
+	if (params != NULL) writer->params = *params;
+	else CMF_DefaultSaveParams(&writer->params);
+
+	if (writer->params.block_size == 0) writer->params.block_size = CMF_DEFAULT_BLOCK_SIZE;
+
+	if (compression == CMF_COMPRESSION_ZSTD && writer->params.context == NULL)
+	{
+		writer->own_context = CMF_CreateContext(writer->params.num_threads);
+		writer->params.context = writer->own_context;
+		if (writer->own_context == NULL) { free(writer); return NULL; }
+	}
+
+	writer->fp = fopen(filename, "wb");
+	if (writer->fp == NULL) { CMF_FreeContext(writer->own_context); free(writer); return NULL; }
+
+	memcpy(&writer->header.magic, CMF_MAGIC_STRING, 24);
+	writer->header.version = 1;
+	writer->header.filesize = 0;
+	writer->header.flags = 0;
+	writer->header.compression = compression;
+	writer->header.num_vertices = 0;
+	writer->header.num_arrays = 0;
+
+	CMF_WriterWrite(writer, &writer->header, sizeof(writer->header));
+
+	if (writer->params.toc != 0)
+	{
+		// Entries are reserved with zeros and patched when writer is closed
+		struct CMF_Toc toc = { writer->params.toc, 0 };
+		writer->toc = (struct CMF_TocEntry*)calloc(writer->params.toc, sizeof(struct CMF_TocEntry));
+		writer->header.flags |= CMF_FLAG_TOC;
+
+		if (writer->toc == NULL) writer->error = 1;
+
+		CMF_WriterWrite(writer, &toc, sizeof(toc));
+		for (uint32_t i = 0; i < writer->params.toc && !writer->error; i++) CMF_WriterWrite(writer, writer->toc, sizeof(struct CMF_TocEntry));
+	}
+
+	return writer;
+}
+
+/*!
+* @brief Starts new array, previous array must be ended.
+*
+* @return Returns 0 if array was started, otherwise returns -1.
+*/
+int CMF_WriterBeginArray(struct CMF_Writer* writer, uint32_t type, uint32_t format)
 {
-	CMF_FORMAT_BYTE   = 0,
-	CMF_FORMAT_UBYTE  = 1,
-	CMF_FORMAT_SHORT  = 2,
-	CMF_FORMAT_USHORT = 3,
-	CMF_FORMAT_INT    = 4,
-	CMF_FORMAT_UINT   = 5,
-	CMF_FORMAT_HALF   = 6,
-	CMF_FORMAT_FLOAT  = 7,
-	CMF_FORMAT_DOUBLE = 8
-};
+	if (writer->array_open || writer->error) return -1;
+	if (writer->toc != NULL && writer->header.num_arrays >= writer->params.toc) { writer->error = 1; return -1; }
 
-struct CMF_InfoArray
+	writer->array_header.type = type;
+	writer->array_header.format = format;
+	writer->array_header.size = 0;
+	writer->array_offset = writer->offset;
+	writer->array_size = 0;
+	writer->array_open = 1;
+
+	if (CMF_TYPE_LEVEL(type) > 0) writer->header.flags |= CMF_FLAG_LODS;
+
+	CMF_WriterWrite(writer, &writer->array_header, sizeof(writer->array_header));
+
+	if (writer->header.compression == CMF_COMPRESSION_ZSTD)
+	{
+		writer->array_header.size = sizeof(uint32_t);
+		CMF_WriterWrite(writer, &writer->array_size, sizeof(writer->array_size));
+	}
+
+	return writer->error ? -1 : 0;
+}
+
+static int CMF_WriterCompress(struct CMF_Writer* writer, const void* data, uint32_t size)
 {
-	uint32_t type;
-	uint32_t format;
-	uint32_t size;
-	void* data;
-};
+	uint32_t block_size = writer->params.block_size;
+	uint32_t num_blocks = CMF_CountBlocks(size, block_size);
+	size_t capacity = CMF_BlocksBound(size, block_size);
 
-struct CMF_Info
+	if (capacity > writer->buffer_size)
+	{
+		uint8_t* buffer = (uint8_t*)realloc(writer->buffer, capacity);
+		if (buffer == NULL) { writer->error = 1; return -1; }
+
+		writer->buffer = buffer;
+		writer->buffer_size = capacity;
+	}
+
+	struct CMF_BlockJob job;
+	if (CMF_InitBlockJob(&job, num_blocks, CMF_NumThreads(writer->params.num_threads), writer->params.context, writer->params.level) != 0)
+	{
+		writer->error = 1;
+		return -1;
+	}
+
+	const ZSTD_CDict* cdict = CMF_FindTypeDictionary(writer->params.context, writer->array_header.type);
+	CMF_FillBlocks(job.blocks, (const uint8_t*)data, size, block_size, writer->buffer, cdict);
+
+	if (CMF_RunBlockJob(&job, num_blocks, CMF_CompressBlock) != 0)
+	{
+		CMF_FreeBlockJob(&job);
+		writer->error = 1;
+		return -1;
+	}
+
+	for (uint32_t block = 0; block < num_blocks; block++)
+	{
+		if (job.blocks[block].dst_size > UINT32_MAX - writer->array_header.size) { writer->error = 1; break; }
+
+		writer->array_header.size += (uint32_t)job.blocks[block].dst_size;
+		CMF_WriterWrite(writer, job.blocks[block].dst, job.blocks[block].dst_size);
+	}
+
+	writer->array_size += size;
+	CMF_FreeBlockJob(&job);
+
+	return writer->error ? -1 : 0;
+}
+
+/*!
+* @brief Appends chunk of data to current array.
+*
+* @return Returns 0 if data was written, otherwise returns -1.
+*/
+int CMF_WriterAppend(struct CMF_Writer* writer, const void* data, uint32_t size)
 {
-	uint32_t compression;
-	uint32_t num_vertices;
-	uint32_t num_arrays;
+	if (!writer->array_open || writer->error) return -1;
+	if (size == 0) return 0;
+	if (size > UINT32_MAX - writer->array_size) { writer->error = 1; return -1; }
 
-	struct CMF_InfoArray* arrays;
-};
+	if (writer->header.compression == CMF_COMPRESSION_ZSTD)
+	{
+		return CMF_WriterCompress(writer, data, size);
+	}
 
-int CMF_Load2(const char* filename, struct CMF_Info* info)
+	if (size > UINT32_MAX - writer->array_header.size) { writer->error = 1; return -1; }
+
+	writer->array_header.size += size;
+	writer->array_size += size;
+	return CMF_WriterWrite(writer, data, size);
+}
+
+/*!
+* @brief Ends current array and patches its header.
+*
+* @return Returns 0 if array was ended, otherwise returns -1.
+*/
+int CMF_WriterEndArray(struct CMF_Writer* writer)
 {
-	FILE* fp = fopen(filename, "rb");
-	if (fp == NULL) return -1;
+	if (!writer->array_open || writer->error) return -1;
 
-	CMF_Header header;
+	if (writer->header.compression == CMF_COMPRESSION_ZSTD)
+	{
+		//Empty array still has one frame, as arrays written by CMF_Save2Ex
+		if (writer->array_header.size == sizeof(uint32_t)) CMF_WriterCompress(writer, NULL, 0);
 
-	fread(&header, sizeof(header), 1, fp);
+		CMF_WriterPatch(writer, writer->array_offset + sizeof(writer->array_header), &writer->array_size, sizeof(writer->array_size));
+	}
 
-	if (memcmp(header.magic, CMF_MAGIC_STRING, 24) != 0) { fclose(fp); return -1; }
-	if (header.version != 1) { fclose(fp); return -1; }
+	CMF_WriterPatch(writer, writer->array_offset, &writer->array_header, sizeof(writer->array_header));
 
-	info->compression = header.compression;
-	info->num_vertices = header.num_vertices;
-	info->num_arrays = header.num_arrays;
-	info->arrays = (struct CMF_InfoArray*)malloc(header.num_arrays * sizeof(CMF_InfoArray));
+	if (writer->toc != NULL)
+	{
+		struct CMF_TocEntry* entry = &writer->toc[writer->header.num_arrays];
+		entry->type = writer->array_header.type;
+		entry->format = writer->array_header.format;
+		entry->offset = writer->array_offset + sizeof(writer->array_header);
+		entry->size = writer->array_size;
+		entry->stored_size = writer->array_header.size;
+	}
+
+	writer->header.num_arrays++;
+	writer->array_open = 0;
+
+	return writer->error ? -1 : 0;
+}
+
+/*!
+* @brief Ends current array, patches file header and closes writer.
+*
+* Writer is freed even if error was occured.
+*
+* @param num_vertices Count of vertices which would be written into header.
+* @return Returns 0 if file was written successfully, otherwise returns -1.
+*/
+int CMF_CloseWriter(struct CMF_Writer* writer, uint32_t num_vertices)
+{
+	if (writer->array_open) CMF_WriterEndArray(writer);
+
+	writer->header.num_vertices = num_vertices;
+	writer->header.filesize = writer->offset > UINT32_MAX ? 0 : (uint32_t)writer->offset;
+
+	CMF_WriterPatch(writer, 0, &writer->header, sizeof(writer->header));
 
-	for (int array = 0; array < header.num_arrays; array++)
+	if (writer->toc != NULL && writer->header.num_arrays != 0)
 	{
-		CMF_ArrayHeader arr_header;
-		fread(&arr_header, sizeof(arr_header), 1, fp);
+		CMF_WriterPatch(writer, sizeof(writer->header) + sizeof(struct CMF_Toc), writer->toc, writer->header.num_arrays * sizeof(struct CMF_TocEntry));
+	}
+
+	if (fclose(writer->fp) != 0) writer->error = 1;
+
+	int result = writer->error ? -1 : 0;
+
+	CMF_FreeContext(writer->own_context);
+	free(writer->buffer);
+	free(writer->toc);
+	free(writer);
 
-		info->arrays[array].type = arr_header.type;
-		info->arrays[array].format = arr_header.format;
-		info->arrays[array].size = arr_header.size;
-		info->arrays[array].data = malloc(arr_header.size);
-		fread(info->arrays[array].data, arr_header.size, 1, fp);
+	return result;
+}
+
+#define CMF_MAX_INTERLEAVED_ARRAYS 16
+
+static inline void CMF_CopyElement(uint8_t* dst, const uint8_t* src, uint32_t size)
+{
+	// Constant sizes become single moves instead of calls
+	switch (size)
+	{
+	case 4:  memcpy(dst, src, 4);  break;
+	case 8:  memcpy(dst, src, 8);  break;
+	case 12: memcpy(dst, src, 12); break;
+	case 16: memcpy(dst, src, 16); break;
+	default: memcpy(dst, src, size); break;
 	}
+}
 
-	fclose(fp);
+/*
+* Computes sizes of elements and their offsets in vertex, elements follow one another in order of arrays.
+* Returns size of packed vertex or 0 if arrays do not match count of vertices.
+*/
+static uint32_t CMF_VertexLayout(const struct CMF_InfoArray* arrays, uint32_t num_arrays, uint32_t num_vertices, uint32_t* sizes, uint32_t* offsets)
+{
+	if (num_arrays == 0 || num_arrays > CMF_MAX_INTERLEAVED_ARRAYS) return 0;
+
+	uint32_t packed = 0;
+
+	for (uint32_t a = 0; a < num_arrays; a++)
+	{
+		if (arrays[a].size % num_vertices != 0 || arrays[a].size == 0) return 0;
+
+		sizes[a] = arrays[a].size / num_vertices;
+		offsets[a] = packed;
+		packed += sizes[a];
+	}
+
+	return packed;
+}
+
+#ifdef CMF_SIMD_WIDTH
+/*
+* Count of last vertices which must be copied by scalar code: vector moves of them
+* would touch bytes after the end of arrays or vertex buffer.
+*/
+static uint32_t CMF_SimdEnd(const uint32_t* sizes, uint32_t num_arrays, uint32_t num_vertices)
+{
+	uint32_t min_size = sizes[0];
+	for (uint32_t a = 1; a < num_arrays; a++) if (sizes[a] < min_size) min_size = sizes[a];
+
+	uint32_t tail = CMF_SIMD_WIDTH / min_size + 1;
+	return num_vertices > tail ? num_vertices - tail : 0;
+}
+
+static int CMF_IsVertexLayout(const uint32_t* sizes, uint32_t num_arrays)
+{
+	return num_arrays == 3 && sizes[0] == 12 && sizes[1] == 8 && sizes[2] == 12;
+}
+
+/*
+* Packs 4 vertices of layout 3-2-3 (CMF_Vertex) with shuffles, vertex is two registers:
+* (x y z u) and (v nx ny nz). Lanes are only moved, so any 4-byte components may be used.
+*/
+static void CMF_InterleaveVertex4(const float* p, const float* t, const float* n, float* out, uint32_t stride)
+{
+	__m128 p0 = _mm_loadu_ps(p), p1 = _mm_loadu_ps(p + 4), p2 = _mm_loadu_ps(p + 8);
+	__m128 t0 = _mm_loadu_ps(t), t1 = _mm_loadu_ps(t + 4);
+	__m128 n0 = _mm_loadu_ps(n), n1 = _mm_loadu_ps(n + 4), n2 = _mm_loadu_ps(n + 8);
+
+	__m128 lo0 = _mm_shuffle_ps(p0, _mm_shuffle_ps(p0, t0, _MM_SHUFFLE(0, 0, 2, 2)), _MM_SHUFFLE(2, 0, 1, 0));
+	__m128 hi0 = _mm_shuffle_ps(_mm_shuffle_ps(t0, n0, _MM_SHUFFLE(0, 0, 1, 1)), n0, _MM_SHUFFLE(2, 1, 2, 0));
+	__m128 lo1 = _mm_shuffle_ps(_mm_shuffle_ps(p0, p1, _MM_SHUFFLE(0, 0, 3, 3)), _mm_shuffle_ps(p1, t0, _MM_SHUFFLE(2, 2, 1, 1)), _MM_SHUFFLE(2, 0, 2, 0));
+	__m128 hi1 = _mm_shuffle_ps(_mm_shuffle_ps(t0, n0, _MM_SHUFFLE(3, 3, 3, 3)), n1, _MM_SHUFFLE(1, 0, 2, 0));
+	__m128 lo2 = _mm_shuffle_ps(p1, _mm_shuffle_ps(p2, t1, _MM_SHUFFLE(0, 0, 0, 0)), _MM_SHUFFLE(2, 0, 3, 2));
+	__m128 hi2 = _mm_shuffle_ps(_mm_shuffle_ps(t1, n1, _MM_SHUFFLE(2, 2, 1, 1)), _mm_shuffle_ps(n1, n2, _MM_SHUFFLE(0, 0, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+	__m128 lo3 = _mm_shuffle_ps(p2, _mm_shuffle_ps(p2, t1, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 1));
+	__m128 hi3 = _mm_shuffle_ps(_mm_shuffle_ps(t1, n2, _MM_SHUFFLE(1, 1, 3, 3)), n2, _MM_SHUFFLE(3, 2, 2, 0));
+
+	stride /= sizeof(float);
+	_mm_storeu_ps(out, lo0); _mm_storeu_ps(out + 4, hi0); out += stride;
+	_mm_storeu_ps(out, lo1); _mm_storeu_ps(out + 4, hi1); out += stride;
+	_mm_storeu_ps(out, lo2); _mm_storeu_ps(out + 4, hi2); out += stride;
+	_mm_storeu_ps(out, lo3); _mm_storeu_ps(out + 4, hi3);
+}
+
+static void CMF_DeinterleaveVertex4(const float* in, uint32_t stride, float* p, float* t, float* n)
+{
+	stride /= sizeof(float);
+	__m128 lo0 = _mm_loadu_ps(in), hi0 = _mm_loadu_ps(in + 4); in += stride;
+	__m128 lo1 = _mm_loadu_ps(in), hi1 = _mm_loadu_ps(in + 4); in += stride;
+	__m128 lo2 = _mm_loadu_ps(in), hi2 = _mm_loadu_ps(in + 4); in += stride;
+	__m128 lo3 = _mm_loadu_ps(in), hi3 = _mm_loadu_ps(in + 4);
+
+	_mm_storeu_ps(p,     _mm_shuffle_ps(lo0, _mm_shuffle_ps(lo0, lo1, _MM_SHUFFLE(0, 0, 2, 2)), _MM_SHUFFLE(2, 0, 1, 0)));
+	_mm_storeu_ps(p + 4, _mm_shuffle_ps(lo1, lo2, _MM_SHUFFLE(1, 0, 2, 1)));
+	_mm_storeu_ps(p + 8, _mm_shuffle_ps(_mm_shuffle_ps(lo2, lo3, _MM_SHUFFLE(0, 0, 2, 2)), lo3, _MM_SHUFFLE(2, 1, 2, 0)));
+
+	_mm_storeu_ps(t,     _mm_shuffle_ps(_mm_shuffle_ps(lo0, hi0, _MM_SHUFFLE(0, 0, 3, 3)), _mm_shuffle_ps(lo1, hi1, _MM_SHUFFLE(0, 0, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+	_mm_storeu_ps(t + 4, _mm_shuffle_ps(_mm_shuffle_ps(lo2, hi2, _MM_SHUFFLE(0, 0, 3, 3)), _mm_shuffle_ps(lo3, hi3, _MM_SHUFFLE(0, 0, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+
+	_mm_storeu_ps(n,     _mm_shuffle_ps(hi0, _mm_shuffle_ps(hi0, hi1, _MM_SHUFFLE(1, 1, 3, 3)), _MM_SHUFFLE(2, 0, 2, 1)));
+	_mm_storeu_ps(n + 4, _mm_shuffle_ps(hi1, hi2, _MM_SHUFFLE(2, 1, 3, 2)));
+	_mm_storeu_ps(n + 8, _mm_shuffle_ps(_mm_shuffle_ps(hi2, hi3, _MM_SHUFFLE(1, 1, 3, 3)), hi3, _MM_SHUFFLE(3, 2, 2, 0)));
+}
+#endif
+
+/*!
+* @brief Packs arrays into buffer of interleaved vertices (SoA to AoS).
+*
+* Element of every array takes (size / num_vertices) bytes, elements are placed in vertex in order of arrays,
+* so three float arrays of positions, texcoords and normals give CMF_Vertex.
+* Vector code is used if elements are not larger than SIMD register and vertex has no padding.
+*
+* @param arrays Arrays to pack, only size and data are used.
+* @param num_arrays Count of arrays, at most CMF_MAX_INTERLEAVED_ARRAYS.
+* @param num_vertices Count of vertices.
+* @param vertices Output buffer of (num_vertices * stride) bytes.
+* @param stride Size of vertex in bytes, 0 if it is sum of element sizes. Padding bytes are not changed.
+* @return Returns 0 if arrays were packed, otherwise returns -1.
+*/
+int CMF_Interleave(const struct CMF_InfoArray* arrays, uint32_t num_arrays, uint32_t num_vertices, void* vertices, uint32_t stride)
+{
+	if (num_vertices == 0) return 0;
+
+	uint32_t sizes[CMF_MAX_INTERLEAVED_ARRAYS];
+	uint32_t offsets[CMF_MAX_INTERLEAVED_ARRAYS];
+	uint32_t packed = CMF_VertexLayout(arrays, num_arrays, num_vertices, sizes, offsets);
+
+	if (packed == 0) return -1;
+	if (stride == 0) stride = packed;
+	if (stride < packed) return -1;
+
+	uint8_t* dst = (uint8_t*)vertices;
+	uint64_t vertex = 0;
+
+#ifdef CMF_SIMD_WIDTH
+	if (CMF_IsVertexLayout(sizes, num_arrays) && stride % sizeof(float) == 0)
+	{
+		for (; vertex + 4 <= num_vertices; vertex += 4)
+		{
+			CMF_InterleaveVertex4((const float*)arrays[0].data + vertex * 3, (const float*)arrays[1].data + vertex * 2,
+				(const float*)arrays[2].data + vertex * 3, (float*)(dst + vertex * stride), stride);
+		}
+	}
+
+	uint32_t max_size = 0;
+	for (uint32_t a = 0; a < num_arrays; a++) if (sizes[a] > max_size) max_size = sizes[a];
+
+	// Every element is moved by one unaligned vector, bytes after it are overwritten by next elements
+	// of the same or next vertex, so it is valid only when elements cover the whole vertex
+	if (stride == packed && max_size <= CMF_SIMD_WIDTH)
+	{
+		uint64_t end = CMF_SimdEnd(sizes, num_arrays, num_vertices);
+
+		for (; vertex < end; vertex++)
+		{
+			uint8_t* out = dst + vertex * stride;
+
+			for (uint32_t a = 0; a < num_arrays; a++)
+			{
+				CMF_SIMD_MOVE(out + offsets[a], (const uint8_t*)arrays[a].data + vertex * sizes[a]);
+			}
+		}
+	}
+#endif
+
+	for (; vertex < num_vertices; vertex++)
+	{
+		uint8_t* out = dst + vertex * stride;
+
+		for (uint32_t a = 0; a < num_arrays; a++)
+		{
+			CMF_CopyElement(out + offsets[a], (const uint8_t*)arrays[a].data + vertex * sizes[a], sizes[a]);
+		}
+	}
 
 	return 0;
 }
 
-int CMF_Save2(const char* filename, struct CMF_Info* info)
+/*!
+* @brief Unpacks buffer of interleaved vertices into arrays (AoS to SoA).
+*
+* Layout of vertex is the same as in CMF_Interleave, data of arrays must be allocated by caller.
+* Vector code is used if elements are not larger than SIMD register.
+*
+* @param vertices Buffer of (num_vertices * stride) bytes, it may point at element inside vertex to unpack only the following ones.
+* @param stride Size of vertex in bytes, 0 if it is sum of element sizes.
+* @param num_vertices Count of vertices.
+* @param arrays Output arrays, only size and data are used.
+* @param num_arrays Count of arrays, at most CMF_MAX_INTERLEAVED_ARRAYS.
+* @return Returns 0 if vertices were unpacked, otherwise returns -1.
+*/
+int CMF_Deinterleave(const void* vertices, uint32_t stride, uint32_t num_vertices, struct CMF_InfoArray* arrays, uint32_t num_arrays)
 {
-	FILE* fp = fopen(filename, "wb");
-	if (fp == NULL) return -1;
+	if (num_vertices == 0) return 0;
 
-	CMF_Header header;
-	memcpy(&header.magic, CMF_MAGIC_STRING, 24);
-	header.version = 1;
-	header.filesize = 0;
-	header.flags = 0;
-	header.compression = info->compression;
-	header.num_vertices = info->num_vertices;
-	header.num_arrays = info->num_arrays;
+	uint32_t sizes[CMF_MAX_INTERLEAVED_ARRAYS];
+	uint32_t offsets[CMF_MAX_INTERLEAVED_ARRAYS];
+	uint32_t packed = CMF_VertexLayout(arrays, num_arrays, num_vertices, sizes, offsets);
 
-	fwrite(&header, sizeof(header), 1, fp);
+	if (packed == 0) return -1;
+	if (stride == 0) stride = packed;
+	if (stride < packed) return -1;
 
-	for (int array = 0; array < info->num_arrays; array++)
+	const uint8_t* src = (const uint8_t*)vertices;
+	uint64_t vertex = 0;
+
+#ifdef CMF_SIMD_WIDTH
+	if (CMF_IsVertexLayout(sizes, num_arrays) && stride % sizeof(float) == 0)
 	{
-		fwrite(&info->arrays[array].type, sizeof(info->arrays[array].type), 1, fp);
-		fwrite(&info->arrays[array].format, sizeof(info->arrays[array].format), 1, fp);
-		fwrite(&info->arrays[array].size, sizeof(info->arrays[array].size), 1, fp);
-		fwrite(info->arrays[array].data, info->arrays[array].size, 1, fp);
+		for (; vertex + 4 <= num_vertices; vertex += 4)
+		{
+			CMF_DeinterleaveVertex4((const float*)(src + vertex * stride), stride, (float*)arrays[0].data + vertex * 3,
+				(float*)arrays[1].data + vertex * 2, (float*)arrays[2].data + vertex * 3);
+		}
 	}
 
-	fclose(fp);
+	uint32_t max_size = 0;
+	for (uint32_t a = 0; a < num_arrays; a++) if (sizes[a] > max_size) max_size = sizes[a];
+
+	// Bytes stored after element are overwritten by next element of the same array
+	if (max_size <= CMF_SIMD_WIDTH)
+	{
+		uint64_t end = CMF_SimdEnd(sizes, num_arrays, num_vertices);
+
+		for (; vertex < end; vertex++)
+		{
+			const uint8_t* in = src + vertex * stride;
+
+			for (uint32_t a = 0; a < num_arrays; a++)
+			{
+				CMF_SIMD_MOVE((uint8_t*)arrays[a].data + vertex * sizes[a], in + offsets[a]);
+			}
+		}
+	}
+#endif
+
+	for (; vertex < num_vertices; vertex++)
+	{
+		const uint8_t* in = src + vertex * stride;
+
+		for (uint32_t a = 0; a < num_arrays; a++)
+		{
+			CMF_CopyElement((uint8_t*)arrays[a].data + vertex * sizes[a], in + offsets[a], sizes[a]);
+		}
+	}
 
 	return 0;
 }
@@ -162,32 +3823,38 @@ typedef struct
 
 static void ProcessVertices(uint32_t Count, float* VBuffer, float* UBuffer, float* NBuffer, CMF_Vertex* Out)
 {
-	uint64_t VCounter = 0x00;
-	uint64_t UCounter = 0x00;
-	uint64_t NCounter = 0x00;
-
-	for (uint32_t i = 0; i < Count * 3; i++)
+	struct CMF_InfoArray Arrays[3] =
 	{
-		Out[i].Position.X = VBuffer[VCounter++];
-		Out[i].Position.Y = VBuffer[VCounter++];
-		Out[i].Position.Z = VBuffer[VCounter++];
+		{ CMF_TYPE_POSITION, CMF_FORMAT_FLOAT, Count * 3 * 3 * (uint32_t)sizeof(float), VBuffer },
+		{ CMF_TYPE_TEXCOORD, CMF_FORMAT_FLOAT, Count * 3 * 2 * (uint32_t)sizeof(float), UBuffer },
+		{ CMF_TYPE_NORMAL,   CMF_FORMAT_FLOAT, Count * 3 * 3 * (uint32_t)sizeof(float), NBuffer }
+	};
 
-		Out[i].UV.X = UBuffer[UCounter++];
-		Out[i].UV.Y = UBuffer[UCounter++];
+	CMF_Interleave(Arrays, 3, Count * 3, Out, sizeof(CMF_Vertex));
+}
+static ZSTD_CCtx* CMF_ContextCCtx(struct CMF_Context* Context)
+{
+	if (Context == NULL) return NULL;
+	if (Context->cctxs[0] == NULL) Context->cctxs[0] = ZSTD_createCCtx();
+	return Context->cctxs[0];
+}
 
-		Out[i].Normal.X = NBuffer[NCounter++];
-		Out[i].Normal.Y = NBuffer[NCounter++];
-		Out[i].Normal.Z = NBuffer[NCounter++];
-	}
+static ZSTD_DCtx* CMF_ContextDCtx(struct CMF_Context* Context)
+{
+	if (Context == NULL) return NULL;
+	if (Context->dctxs[0] == NULL) Context->dctxs[0] = ZSTD_createDCtx();
+	return Context->dctxs[0];
 }
+
 /*!
-* @brief Loads CMF from file.
+* @brief Loads CMF from file, reusing ZSTD state of context.
 *
 * @param FileName Name of file, which would be read.
 * @param OutCount Valid pointer to count of polygons.
+* @param Context Context created with CMF_CreateContext or NULL.
 * @return Buffer which read from file or NULL if error was occured.
 */
-CMF_Vertex* CMF_Load(const char* FileName, uint32_t* OutCount)
+CMF_Vertex* CMF_LoadWithContext(const char* FileName, uint32_t* OutCount, struct CMF_Context* Context)
 {
 	FILE* File = fopen(FileName, "rb");
 	if (File == NULL) return NULL;
@@ -209,23 +3876,18 @@ CMF_Vertex* CMF_Load(const char* FileName, uint32_t* OutCount)
 	fread(&Count, 1, sizeof(uint32_t), File);
 	fread(&Compression, 1, sizeof(uint8_t), File);
 
-	float* VBuffer = NULL;
-	float* UBuffer = NULL;
-	float* NBuffer = NULL;
-	CMF_Vertex* Vertices = NULL;
-
-	VBuffer = (float*)malloc(Count * 3 * 3 * sizeof(float));
-	UBuffer = (float*)malloc(Count * 3 * 2 * sizeof(float));
-	NBuffer = (float*)malloc(Count * 3 * 3 * sizeof(float));
-	Vertices = (CMF_Vertex*)malloc(Count * 3 * sizeof(CMF_Vertex));
+	// Positions, texcoords and normals follow each other, so they are read into one planar buffer
+	size_t PlanarSize = (size_t)Count * 3 * (3 + 2 + 3) * sizeof(float);
+	float* VBuffer = (float*)malloc(PlanarSize);
+	float* UBuffer = VBuffer + Count * 3 * 3;
+	float* NBuffer = UBuffer + Count * 3 * 2;
+	CMF_Vertex* Vertices = (CMF_Vertex*)malloc(Count * 3 * sizeof(CMF_Vertex));
 
 	switch (Compression)
 	{
 		case 0x00: //No compression
 		{
-			fread(VBuffer, Count * 3 * 3 * sizeof(float), 1, File);
-			fread(UBuffer, Count * 3 * 2 * sizeof(float), 1, File);
-			fread(NBuffer, Count * 3 * 3 * sizeof(float), 1, File);
+			fread(VBuffer, PlanarSize, 1, File);
 
 			break;
 		}
@@ -236,16 +3898,28 @@ CMF_Vertex* CMF_Load(const char* FileName, uint32_t* OutCount)
 			fread(FileBuf, FileSize - 26, 1, File);
 
 			uint64_t DecompressedSize = ZSTD_getDecompressedSize(FileBuf, FileSize - 26);
-			uint8_t* Decompressed = (uint8_t*)malloc(DecompressedSize);
-			ZSTD_decompress(Decompressed, DecompressedSize, FileBuf, FileSize - 26);
-			free(FileBuf);
+			ZSTD_DCtx* DContext = CMF_ContextDCtx(Context);
+			size_t Result = 0;
+
+			// Frame holds exactly the three arrays, so it is decompressed right into planar buffer
+			if (DecompressedSize == PlanarSize)
+			{
+				if (DContext != NULL)
+					Result = ZSTD_decompressDCtx(DContext, VBuffer, PlanarSize, FileBuf, FileSize - 26);
+				else
+					Result = ZSTD_decompress(VBuffer, PlanarSize, FileBuf, FileSize - 26);
+			}
 
-			memcpy(VBuffer, Decompressed, Count * 3 * 3 * sizeof(float)); Decompressed += Count * 3 * 3 * sizeof(float);
-			memcpy(UBuffer, Decompressed, Count * 3 * 2 * sizeof(float)); Decompressed += Count * 3 * 2 * sizeof(float);
-			memcpy(NBuffer, Decompressed, Count * 3 * 3 * sizeof(float)); Decompressed += Count * 3 * 3 * sizeof(float);
+			free(FileBuf);
 
-			Decompressed -= DecompressedSize;
-			free(Decompressed);
+			// Frame of other size or broken frame leaves planar buffer uninitialized
+			if (DecompressedSize != PlanarSize || ZSTD_isError(Result) || Result != PlanarSize)
+			{
+				free(VBuffer);
+				free(Vertices);
+				fclose(File);
+				return NULL;
+			}
 
 			break;
 		}
@@ -255,43 +3929,45 @@ CMF_Vertex* CMF_Load(const char* FileName, uint32_t* OutCount)
 	ProcessVertices(Count, VBuffer, UBuffer, NBuffer, Vertices);
 
 	free(VBuffer);
-	free(UBuffer);
-	free(NBuffer);
 
 	fclose(File);
 	return Vertices;
 }
 
-static void FillBuffers(uint32_t Count, float* VBuffer, float* UBuffer, float* NBuffer, CMF_Vertex* Vertices)
+/*!
+* @brief Loads CMF from file.
+*
+* @param FileName Name of file, which would be read.
+* @param OutCount Valid pointer to count of polygons.
+* @return Buffer which read from file or NULL if error was occured.
+*/
+CMF_Vertex* CMF_Load(const char* FileName, uint32_t* OutCount)
 {
-	uint64_t VCounter = 0x00;
-	uint64_t UCounter = 0x00;
-	uint64_t NCounter = 0x00;
+	return CMF_LoadWithContext(FileName, OutCount, NULL);
+}
 
-	for (uint32_t i = 0; i < Count; i++)
+static void FillBuffers(uint32_t Count, float* VBuffer, float* UBuffer, float* NBuffer, CMF_Vertex* Vertices)
+{
+	struct CMF_InfoArray Arrays[3] =
 	{
-		VBuffer[VCounter++] = Vertices[i].Position.X;
-		VBuffer[VCounter++] = Vertices[i].Position.Y;
-		VBuffer[VCounter++] = Vertices[i].Position.Z;
-
-		UBuffer[UCounter++] = Vertices[i].UV.X;
-		UBuffer[UCounter++] = Vertices[i].UV.Y;
+		{ CMF_TYPE_POSITION, CMF_FORMAT_FLOAT, Count * 3 * (uint32_t)sizeof(float), VBuffer },
+		{ CMF_TYPE_TEXCOORD, CMF_FORMAT_FLOAT, Count * 2 * (uint32_t)sizeof(float), UBuffer },
+		{ CMF_TYPE_NORMAL,   CMF_FORMAT_FLOAT, Count * 3 * (uint32_t)sizeof(float), NBuffer }
+	};
 
-		NBuffer[NCounter++] = Vertices[i].Normal.X;
-		NBuffer[NCounter++] = Vertices[i].Normal.Y;
-		NBuffer[NCounter++] = Vertices[i].Normal.Z;
-	}
+	CMF_Deinterleave(Vertices, sizeof(CMF_Vertex), Count, Arrays, 3);
 }
 /*!
-* @brief Saves CMF to file.
+* @brief Saves CMF to file, reusing ZSTD state of context.
 *
 * @param Count Count of **polygons** in model.
 * @param Compression 0x00 for no compression, 0xFF for ZSTD compression.
 * @param Vertices Vertex buffer of model, size must be at least (Count * 3).
 * @param FileName Name of file in which would be written vertex data.
+* @param Context Context created with CMF_CreateContext or NULL.
 * @return Returns 0 if saving was successful, otherwise returns 1.
 */
-int CMF_Save(uint32_t Count, uint8_t Compression, CMF_Vertex* Vertices, const char* FileName)
+int CMF_SaveWithContext(uint32_t Count, uint8_t Compression, CMF_Vertex* Vertices, const char* FileName, struct CMF_Context* Context)
 {
 	if (Compression != 0x00 && Compression != 0xFF) return 1;
 
@@ -338,7 +4014,10 @@ int CMF_Save(uint32_t Count, uint8_t Compression, CMF_Vertex* Vertices, const ch
 			memcpy(Data, NBuffer,  Count * 3 * sizeof(float)); Data += Count * 3;
 			Data -= DataCount;
 
-			uint64_t CompressedSize = ZSTD_compress(Compressed, Bound, Data, DataSize, 1);
+			ZSTD_CCtx* CContext = CMF_ContextCCtx(Context);
+			uint64_t CompressedSize = CContext != NULL
+				? ZSTD_compressCCtx(CContext, Compressed, Bound, Data, DataSize, 1)
+				: ZSTD_compress(Compressed, Bound, Data, DataSize, 1);
 			free(Data);
 			fwrite(Compressed, CompressedSize, 1, File);
 			free(Compressed);
@@ -354,3 +4033,17 @@ int CMF_Save(uint32_t Count, uint8_t Compression, CMF_Vertex* Vertices, const ch
 	fclose(File);
 	return 0;
 }
+
+/*!
+* @brief Saves CMF to file.
+*
+* @param Count Count of **polygons** in model.
+* @param Compression 0x00 for no compression, 0xFF for ZSTD compression.
+* @param Vertices Vertex buffer of model, size must be at least (Count * 3).
+* @param FileName Name of file in which would be written vertex data.
+* @return Returns 0 if saving was successful, otherwise returns 1.
+*/
+int CMF_Save(uint32_t Count, uint8_t Compression, CMF_Vertex* Vertices, const char* FileName)
+{
+	return CMF_SaveWithContext(Count, Compression, Vertices, FileName, NULL);
+}
@@ -0,0 +1,383 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <functional>
+#include <sys/stat.h>
+#include "cmf_cmf.h"
+#include "cmf_gltf.h"
+#include "../library/cmf.h"
+
+// Every benchmark runs until it takes this time in total, the best run is reported
+#define BENCHMARK_MIN_TIME 1.0
+#define BENCHMARK_MAX_RUNS 10
+
+// Grid of quads with waves, attributes are in separate arrays, as files of version 1 store them
+struct BenchmarkMesh
+{
+	uint64_t Triangles = 0;
+	uint32_t VertexCount = 0;
+	std::vector<float> Positions;
+	std::vector<float> Texcoords;
+	std::vector<float> Normals;
+	std::vector<uint32_t> Indices;
+
+	// Vertices of every triangle, as files of version 0 store them
+	std::vector<Vertex> Vertices;
+};
+
+struct BenchmarkResult
+{
+	std::string Name;
+	uint64_t Triangles;
+	bool Compressed;
+	double Seconds;
+	uint64_t Bytes;
+	uint64_t FileSize;
+};
+
+struct BenchmarkFlags
+{
+	uint64_t MinTriangles = 1000;
+	uint64_t MaxTriangles = 1000000;
+	const char* Filter = nullptr;
+	const char* Json = nullptr;
+	const char* Directory = "/tmp";
+};
+
+void GenerateMesh(uint64_t Triangles, bool Unindexed, BenchmarkMesh& Mesh)
+{
+	uint64_t Side = std::max<uint64_t>(1, (uint64_t)ceil(sqrt(Triangles / 2.0)));
+	uint64_t Columns = Side + 1;
+
+	Mesh.Triangles = Triangles;
+	Mesh.VertexCount = (uint32_t)(Columns * Columns);
+	Mesh.Positions.resize(Mesh.VertexCount * 3ull);
+	Mesh.Texcoords.resize(Mesh.VertexCount * 2ull);
+	Mesh.Normals.resize(Mesh.VertexCount * 3ull);
+
+	for (uint64_t y = 0, v = 0; y < Columns; y++)
+	{
+		for (uint64_t x = 0; x < Columns; x++, v++)
+		{
+			float U = float(x) / Side, V = float(y) / Side;
+			float DX = cosf(U * 20.0f) * cosf(V * 20.0f), DY = -sinf(U * 20.0f) * sinf(V * 20.0f);
+			float Length = sqrtf(DX * DX + DY * DY + 1.0f);
+
+			float Position[3] = { U, V, 0.05f * sinf(U * 20.0f) * cosf(V * 20.0f) };
+			float Normal[3] = { -DX / Length, -DY / Length, 1.0f / Length };
+
+			memcpy(&Mesh.Positions[v * 3], Position, sizeof(Position));
+			memcpy(&Mesh.Normals[v * 3], Normal, sizeof(Normal));
+			Mesh.Texcoords[v * 2 + 0] = U;
+			Mesh.Texcoords[v * 2 + 1] = V;
+		}
+	}
+
+	Mesh.Indices.resize(Triangles * 3);
+
+	for (uint64_t t = 0; t < Triangles; t++)
+	{
+		uint64_t Quad = t / 2;
+		uint32_t Corner = (uint32_t)(Quad / Side * Columns + Quad % Side);
+		uint32_t Quads[2][3] = { { Corner, Corner + 1, Corner + (uint32_t)Columns }, { Corner + 1, Corner + (uint32_t)Columns + 1, Corner + (uint32_t)Columns } };
+
+		memcpy(&Mesh.Indices[t * 3], Quads[t % 2], sizeof(Quads[0]));
+	}
+
+	Mesh.Vertices.clear();
+	if (!Unindexed) return;
+
+	Mesh.Vertices.resize(Triangles * 3);
+
+	for (uint64_t i = 0; i < Mesh.Indices.size(); i++)
+	{
+		uint32_t Index = Mesh.Indices[i];
+		Vertex& Vert = Mesh.Vertices[i];
+
+		memcpy(&Vert.X, &Mesh.Positions[Index * 3ull], 3 * sizeof(float));
+		memcpy(&Vert.U, &Mesh.Texcoords[Index * 2ull], 2 * sizeof(float));
+		memcpy(&Vert.NX, &Mesh.Normals[Index * 3ull], 3 * sizeof(float));
+	}
+}
+
+// Runs Function until it takes BENCHMARK_MIN_TIME, returns the best time or -1 if Function failed
+double Measure(const std::function<bool()>& Function)
+{
+	double Best = 1e30, Total = 0.0;
+
+	for (int Run = 0; Run < BENCHMARK_MAX_RUNS && (Run == 0 || Total < BENCHMARK_MIN_TIME); Run++)
+	{
+		auto Begin = std::chrono::steady_clock::now();
+		if (!Function()) return -1.0;
+		double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Begin).count();
+
+		Best = std::min(Best, Seconds);
+		Total += Seconds;
+	}
+
+	return Best;
+}
+
+uint64_t FileSize(const std::string& FileName)
+{
+	struct stat Stat;
+	return stat(FileName.c_str(), &Stat) == 0 ? (uint64_t)Stat.st_size : 0;
+}
+
+void Run(const char* Name, const BenchmarkMesh& Mesh, bool Compressed, uint64_t Bytes, const std::string& FileName,
+         const BenchmarkFlags& Flags, const std::function<bool()>& Function, std::vector<BenchmarkResult>& Results)
+{
+	if (Flags.Filter != nullptr && strstr(Name, Flags.Filter) == nullptr) return;
+
+	double Seconds = Measure(Function);
+	uint64_t Size = FileName.empty() ? 0 : FileSize(FileName);
+
+	if (Seconds < 0.0)
+	{
+		printf("%-16s %11lu %-5s failed\n", Name, (unsigned long)Mesh.Triangles, Compressed ? "zstd" : "none");
+		return;
+	}
+
+	printf("%-16s %11lu %-5s %10.4f s %10.1f MB/s %14.0f triangles/s\n", Name, (unsigned long)Mesh.Triangles, Compressed ? "zstd" : "none",
+	       Seconds, Bytes / Seconds / 1e6, Mesh.Triangles / Seconds);
+	fflush(stdout);
+
+	Results.push_back({ Name, Mesh.Triangles, Compressed, Seconds, Bytes, Size });
+}
+
+/*
+* Benchmarks saving and loading of files of version 1 and 0 and repacking of arrays into vertices.
+* Files stay in page cache, so loads measure parsing and decompression rather than disk.
+*/
+void RunMesh(const BenchmarkMesh& Mesh, const BenchmarkFlags& Flags, std::vector<BenchmarkResult>& Results)
+{
+	struct CMF_InfoArray Arrays[4] =
+	{
+		{ CMF_TYPE_POSITION, CMF_FORMAT_FLOAT, (uint32_t)(Mesh.Positions.size() * sizeof(float)), (void*)Mesh.Positions.data() },
+		{ CMF_TYPE_TEXCOORD, CMF_FORMAT_FLOAT, (uint32_t)(Mesh.Texcoords.size() * sizeof(float)), (void*)Mesh.Texcoords.data() },
+		{ CMF_TYPE_NORMAL,   CMF_FORMAT_FLOAT, (uint32_t)(Mesh.Normals.size() * sizeof(float)),   (void*)Mesh.Normals.data() },
+		{ CMF_TYPE_INDICES,  CMF_FORMAT_UINT,  (uint32_t)(Mesh.Indices.size() * sizeof(uint32_t)), (void*)Mesh.Indices.data() }
+	};
+
+	uint64_t Bytes = 0;
+	for (const auto& Array : Arrays) Bytes += Array.size;
+
+	uint64_t VertexBytes = Mesh.Vertices.size() * sizeof(Vertex);
+	std::string Version1 = std::string(Flags.Directory) + "/cmf_benchmark_1.cmf";
+	std::string Version0 = std::string(Flags.Directory) + "/cmf_benchmark_0.cmf";
+
+	for (int Compressed = 0; Compressed < 2; Compressed++)
+	{
+		struct CMF_Info Info = { Compressed ? (uint32_t)CMF_COMPRESSION_ZSTD : (uint32_t)CMF_COMPRESSION_NONE, Mesh.VertexCount, 4, Arrays };
+
+		Run("CMF_Save2", Mesh, Compressed, Bytes, Version1, Flags, [&]() { return CMF_Save2(Version1.c_str(), &Info) == 0; }, Results);
+
+		Run("CMF_Load2", Mesh, Compressed, Bytes, Version1, Flags, [&]()
+		{
+			struct CMF_Info Loaded;
+			if (CMF_Load2(Version1.c_str(), &Loaded) != 0) return false;
+
+			CMF_FreeInfo(&Loaded, nullptr);
+			return true;
+		}, Results);
+
+		if (Mesh.Vertices.empty()) continue;
+
+		Run("CMF_Save", Mesh, Compressed, VertexBytes, Version0, Flags, [&]()
+		{
+			return CMF_Save((uint32_t)Mesh.Triangles, Compressed ? 0xFF : 0x00, (CMF_Vertex*)Mesh.Vertices.data(), Version0.c_str()) == 0;
+		}, Results);
+
+		// Files of version 0 are written by SaveCMF for both loaders, as the util reads them
+		Run("SaveCMF", Mesh, Compressed, VertexBytes, Version0, Flags, [&]() { return SaveCMF(Version0.c_str(), Mesh.Vertices, Compressed != 0); }, Results);
+
+		Run("CMF_Load", Mesh, Compressed, VertexBytes, Version0, Flags, [&]()
+		{
+			uint32_t Count;
+			CMF_Vertex* Loaded = CMF_Load(Version0.c_str(), &Count);
+			free(Loaded);
+			return Loaded != nullptr && Count == Mesh.Triangles;
+		}, Results);
+
+		Run("LoadCMF", Mesh, Compressed, VertexBytes, Version0, Flags, [&]()
+		{
+			std::vector<Vertex> Loaded;
+			return LoadCMF(Version0.c_str(), Loaded) && Loaded.size() == Mesh.Vertices.size();
+		}, Results);
+	}
+
+	std::vector<Vertex> Interleaved(Mesh.VertexCount);
+	std::vector<float> Unpacked[3] = { std::vector<float>(Mesh.Positions.size()), std::vector<float>(Mesh.Texcoords.size()), std::vector<float>(Mesh.Normals.size()) };
+	struct CMF_InfoArray Outputs[3] = { Arrays[0], Arrays[1], Arrays[2] };
+	uint64_t RepackBytes = Mesh.VertexCount * (uint64_t)sizeof(Vertex);
+
+	for (int a = 0; a < 3; a++) Outputs[a].data = Unpacked[a].data();
+
+	Run("CMF_Interleave", Mesh, false, RepackBytes, "", Flags, [&]() { return CMF_Interleave(Arrays, 3, Mesh.VertexCount, Interleaved.data(), sizeof(Vertex)) == 0; }, Results);
+	Run("CMF_Deinterleave", Mesh, false, RepackBytes, "", Flags, [&]() { return CMF_Deinterleave(Interleaved.data(), sizeof(Vertex), Mesh.VertexCount, Outputs, 3) == 0; }, Results);
+
+	remove(Version1.c_str());
+	remove(Version0.c_str());
+}
+
+// Results in the same shape as Google Benchmark writes them, context describes the build
+bool WriteJson(const char* FileName, const std::vector<BenchmarkResult>& Results)
+{
+	FILE* File = fopen(FileName, "w");
+	if (File == nullptr) return false;
+
+	fprintf(File, "{\n  \"context\": {\n    \"threads\": %u,\n    \"zstd\": \"%s\",\n    \"simd\": %d\n  },\n  \"benchmarks\": [\n",
+	        std::thread::hardware_concurrency(), ZSTD_versionString(),
+#ifdef CMF_SIMD_WIDTH
+	        CMF_SIMD_WIDTH
+#else
+	        0
+#endif
+	        );
+
+	for (size_t i = 0; i < Results.size(); i++)
+	{
+		const BenchmarkResult& Result = Results[i];
+
+		fprintf(File, "    { \"name\": \"%s/%lu/%s\", \"triangles\": %lu, \"compression\": \"%s\", \"seconds\": %.9f, "
+		              "\"bytes\": %lu, \"file_size\": %lu, \"mb_per_second\": %.3f, \"triangles_per_second\": %.1f }%s\n",
+		        Result.Name.c_str(), (unsigned long)Result.Triangles, Result.Compressed ? "zstd" : "none", (unsigned long)Result.Triangles,
+		        Result.Compressed ? "zstd" : "none", Result.Seconds, (unsigned long)Result.Bytes, (unsigned long)Result.FileSize,
+		        Result.Bytes / Result.Seconds / 1e6, Result.Triangles / Result.Seconds, i + 1 < Results.size() ? "," : "");
+	}
+
+	fprintf(File, "  ]\n}\n");
+	return fclose(File) == 0;
+}
+
+bool ReadJson(const char* FileName, JsonValue& Document)
+{
+	FILE* File = fopen(FileName, "rb");
+	if (File == nullptr) return false;
+
+	std::string Text;
+	char Buffer[4096];
+
+	for (size_t Read; (Read = fread(Buffer, 1, sizeof(Buffer), File)) > 0;) Text.append(Buffer, Read);
+	fclose(File);
+
+	return JsonParse(Text.data(), Text.data() + Text.size(), Document) != nullptr;
+}
+
+/*
+* Prints change of throughput of every benchmark of new results against old ones,
+* changes larger than Threshold percents are marked, so regressions are easy to find.
+*/
+bool Compare(const char* OldFileName, const char* NewFileName, double Threshold)
+{
+	JsonValue Old, New;
+
+	if (!ReadJson(OldFileName, Old) || !ReadJson(NewFileName, New) || Old.Find("benchmarks") == nullptr || New.Find("benchmarks") == nullptr)
+	{
+		printf("Error: failed to read results\n");
+		return false;
+	}
+
+	printf("%-36s %12s %12s %9s\n", "Benchmark", "Old MB/s", "New MB/s", "Change");
+
+	for (const auto& Benchmark : New.Find("benchmarks")->Items)
+	{
+		const JsonValue* Name = Benchmark.Find("name");
+		if (Name == nullptr) continue;
+
+		double NewSpeed = Benchmark.Get("mb_per_second", 0.0);
+		double OldSpeed = 0.0;
+
+		for (const auto& Other : Old.Find("benchmarks")->Items)
+		{
+			const JsonValue* OtherName = Other.Find("name");
+			if (OtherName != nullptr && OtherName->String == Name->String) OldSpeed = Other.Get("mb_per_second", 0.0);
+		}
+
+		if (OldSpeed <= 0.0)
+		{
+			printf("%-36s %12s %12.1f %9s\n", Name->String.c_str(), "-", NewSpeed, "new");
+			continue;
+		}
+
+		double Change = (NewSpeed / OldSpeed - 1.0) * 100.0;
+		const char* Mark = Change <= -Threshold ? " slower" : Change >= Threshold ? " faster" : "";
+
+		printf("%-36s %12.1f %12.1f %+8.1f%%%s\n", Name->String.c_str(), OldSpeed, NewSpeed, Change, Mark);
+	}
+
+	return true;
+}
+
+void PrintUsing()
+{
+	printf("Using\n");
+	printf("cmf_benchmark [flags]\n");
+	printf("cmf_benchmark --compare [old.json] [new.json] [threshold]\n\n");
+	printf("Flags\n");
+	printf("-h, --help         print this message\n");
+	printf("--min [N]          the smallest model in triangles, 1000 by default\n");
+	printf("--max [N]          the largest model in triangles, 1000000 by default, models grow by 10 times\n");
+	printf("-f, --filter [S]   run only benchmarks with S in name\n");
+	printf("--json [file]      write results into JSON file for --compare\n");
+	printf("--dir [directory]  directory of temporary files, /tmp by default\n");
+}
+
+int main(int argc, char** argv)
+{
+	printf("Columbus Model Format Benchmark\n\n");
+
+	if (argc >= 4 && strcmp(argv[1], "--compare") == 0)
+	{
+		return Compare(argv[2], argv[3], argc >= 5 ? atof(argv[4]) : 5.0) ? 0 : 1;
+	}
+
+	BenchmarkFlags Flags;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool HasValue = i + 1 < argc;
+
+		if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0)
+		{
+			PrintUsing();
+			return 0;
+		}
+		else if (strcmp(argv[i], "--min") == 0 && HasValue) Flags.MinTriangles = strtoull(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "--max") == 0 && HasValue) Flags.MaxTriangles = strtoull(argv[++i], nullptr, 10);
+		else if ((strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "--filter") == 0) && HasValue) Flags.Filter = argv[++i];
+		else if (strcmp(argv[i], "--json") == 0 && HasValue) Flags.Json = argv[++i];
+		else if (strcmp(argv[i], "--dir") == 0 && HasValue) Flags.Directory = argv[++i];
+		else
+		{
+			printf("Error: unknown flag '%s'\n", argv[i]);
+			PrintUsing();
+			return 1;
+		}
+	}
+
+	std::vector<BenchmarkResult> Results;
+
+	for (uint64_t Triangles = std::max<uint64_t>(Flags.MinTriangles, 1); Triangles <= Flags.MaxTriangles; Triangles *= 10)
+	{
+		// Vertices of every triangle do not fit into 32-bit sizes of arrays and legacy count above this
+		bool Unindexed = Triangles * 3 * sizeof(Vertex) <= 0xFFFFFFFF;
+
+		BenchmarkMesh Mesh;
+		GenerateMesh(Triangles, Unindexed, Mesh);
+		RunMesh(Mesh, Flags, Results);
+	}
+
+	if (Flags.Json != nullptr && !WriteJson(Flags.Json, Results))
+	{
+		printf("Error: failed to write '%s'\n", Flags.Json);
+		return 1;
+	}
+
+	return 0;
+}
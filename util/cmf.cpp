@@ -1,26 +1,91 @@
 #include <cstdio>
+#include <cstdarg>
+#include <cctype>
 #include <cstdlib>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <string>
+#include <zdict.h>
+#ifdef _WIN32
+	#include <direct.h>
+#else
+	#include <sys/stat.h>
+#endif
 #include "cmf_cmf.h"
+#include "cmf_index.h"
+#include "cmf_optimize.h"
+#include "cmf_quantize.h"
+#include "cmf_meshlet.h"
+#include "cmf_lod.h"
+#include "cmf_batch.h"
+#include "cmf_obj.h"
+#include "cmf_gltf.h"
 #include "../library/cmf.h"
 
 enum FileType
 {
 	CMF,
+	OBJ,
+	GLB,
 	Undefined
 };
 
 struct CommandLineFlags
 {
 	bool Help = false;
+	bool Quiet = false;
 	bool Compress = false;
+	int  Level = CMF_DEFAULT_COMPRESSION_LEVEL;
+	int  Threads = 0;
+	const char* Dictionaries = nullptr;
+	bool Index = false;
+	bool Optimize = false;
+	bool QuantizePositions = false;
+	bool QuantizeTexcoords = false;
+	int  NormalBits = 0;
+	bool Meshlets = false;
+	int  Lods = 0;
+	bool Toc = false;
 	bool VerticesWrite = false;
 	bool TexcoordsWrite = false;
 	bool NormalsWrite = false;
 };
 
-std::vector<Vertex> Vertices;
+// State of one conversion, every job of batch has its own
+struct Mesh
+{
+	std::vector<Vertex> Vertices;
+	std::vector<uint32_t> Indices;
+	MeshletData Meshlets;
+	std::vector<std::vector<uint32_t>> Lods;
+	std::vector<float> LodErrors;
+};
+
+#define LOAD_CHUNK_SIZE (64 * 1024)
+#define SAVE_CHUNK_SIZE (1024 * 1024)
+#define DICTIONARY_SIZE (110 * 1024)
+#define DICTIONARY_SAMPLE_SIZE (128 * 1024)
+
+const char* DictionaryName(uint32_t Type)
+{
+	switch (Type)
+	{
+	case CMF_TYPE_POSITION: return "position";
+	case CMF_TYPE_TEXCOORD: return "texcoord";
+	case CMF_TYPE_NORMAL:   return "normal";
+	case CMF_TYPE_TANGENT:  return "tangent";
+	case CMF_TYPE_COLOR:    return "color";
+	case CMF_TYPE_INDICES:  return "indices";
+	}
+
+	return nullptr;
+}
+
+std::string DictionaryPath(const char* Directory, uint32_t Type)
+{
+	return std::string(Directory) + "/" + DictionaryName(Type) + ".dict";
+}
 
 FileType GetFileType(const char* FileName)
 {
@@ -31,7 +96,7 @@ FileType GetFileType(const char* FileName)
 		return Undefined;
 	}
 
-	uint8_t Magic[21];
+	uint8_t Magic[21] = { 0 };
 
 	fread(Magic, 1, 21, File);
 
@@ -43,6 +108,22 @@ FileType GetFileType(const char* FileName)
 
 	fclose(File);
 
+	if (memcmp(Magic, "glTF", 4) == 0)
+	{
+		return GLB;
+	}
+
+	// OBJ has no magic, it is recognized by extension
+	size_t Length = strlen(FileName);
+
+	if (Length >= 4 && FileName[Length - 4] == '.' &&
+	    tolower(FileName[Length - 3]) == 'o' &&
+	    tolower(FileName[Length - 2]) == 'b' &&
+	    tolower(FileName[Length - 1]) == 'j')
+	{
+		return OBJ;
+	}
+
 	return Undefined;
 }
 
@@ -64,8 +145,11 @@ bool FileMayBeCreated(const char* FileName)
 	return Oportunity;
 }
 
-bool Load(const char* FileName)
+// OBJ and glTF models have indices, Threads are used by parser of OBJ
+bool Load(const char* FileName, Mesh& Model, uint32_t Threads = 0)
 {
+	std::vector<Vertex>& Vertices = Model.Vertices;
+
 	FileType Type = GetFileType(FileName);
 
 	switch (Type)
@@ -73,118 +157,738 @@ bool Load(const char* FileName)
 	case Undefined: return false;                 break;
 	case CMF:
 	{
-		uint32_t Count;
-		CMF_Vertex* Verts = CMF_Load(FileName, &Count);
+		CMFStreamReader Reader;
+		if (!Reader.Open(FileName)) return false;
+
+		Vertices.resize(Reader.GetVertexCount());
+
+		for (uint64_t Loaded = 0, Count = 0; Loaded < Vertices.size(); Loaded += Count)
+		{
+			uint64_t ChunkSize = std::min<uint64_t>(LOAD_CHUNK_SIZE, Vertices.size() - Loaded);
+			if (!Reader.Read(Vertices.data() + Loaded, ChunkSize, &Count) || Count == 0) return false;
+		}
+
+		break;
+	}
+	case OBJ: return LoadOBJ(FileName, Vertices, Model.Indices, Threads);
+	case GLB:
+	{
+		GltfModel Gltf;
+		if (!OpenGLB(FileName, Gltf)) return false;
+
+		bool Result = GltfToVertices(Gltf, Vertices, Model.Indices);
+		CloseGLB(Gltf);
+		return Result;
+	}
+	}
+
+	return true;
+}
+
+// Copies attributes of given type from vertices into separate array
+void PackArray(uint32_t Type, const Vertex* Verts, uint64_t Count, float* Out)
+{
+	uint32_t Components = Type == CMF_TYPE_TEXCOORD ? 2 : 3;
+	size_t Offset = Type == CMF_TYPE_POSITION ? offsetof(Vertex, X) :
+	                Type == CMF_TYPE_TEXCOORD ? offsetof(Vertex, U) : offsetof(Vertex, NX);
+
+	struct CMF_InfoArray Array = { Type, CMF_FORMAT_FLOAT, (uint32_t)(Count * Components * sizeof(float)), Out };
+	CMF_Deinterleave((const uint8_t*)Verts + Offset, sizeof(Vertex), Count, &Array, 1);
+}
+
+// Writes whole array by chunks of limited size
+bool WriteArray(struct CMF_Writer* Writer, uint32_t Type, uint32_t Format, const void* Data, uint64_t Size)
+{
+	bool Result = CMF_WriterBeginArray(Writer, Type, Format) == 0;
+
+	for (uint64_t Offset = 0; Offset < Size && Result; Offset += SAVE_CHUNK_SIZE)
+	{
+		uint64_t ChunkSize = std::min<uint64_t>(SAVE_CHUNK_SIZE, Size - Offset);
+		Result = CMF_WriterAppend(Writer, (const uint8_t*)Data + Offset, ChunkSize) == 0;
+	}
+
+	return Result && CMF_WriterEndArray(Writer) == 0;
+}
+
+// Writes indices in the smallest format for count of vertices
+bool WriteIndices(struct CMF_Writer* Writer, uint32_t Type, const std::vector<uint32_t>& Inds, uint64_t VertexCount)
+{
+	uint32_t Format = IndexFormat(VertexCount);
+	std::vector<uint8_t> Chunk(SAVE_CHUNK_SIZE * IndexSize(Format));
+
+	bool Result = CMF_WriterBeginArray(Writer, Type, Format) == 0;
+
+	for (uint64_t Offset = 0; Offset < Inds.size() && Result; Offset += SAVE_CHUNK_SIZE)
+	{
+		uint64_t Count = std::min<uint64_t>(SAVE_CHUNK_SIZE, Inds.size() - Offset);
+		PackIndices(Inds.data() + Offset, Count, Format, Chunk.data());
+		Result = CMF_WriterAppend(Writer, Chunk.data(), Count * IndexSize(Format)) == 0;
+	}
 
-		if (Verts == nullptr) return false;
+	return Result && CMF_WriterEndArray(Writer) == 0;
+}
 
-		Vertex Vert;
+// Count of arrays written by Save, it is reserved in table of contents
+uint32_t CountArrays(const Mesh& Model, CommandLineFlags Flags)
+{
+	uint32_t Count = Flags.QuantizePositions ? 4 : 3;
+
+	if (!Model.Indices.empty()) Count += 1 + (uint32_t)Model.Lods.size() + (Model.Lods.empty() ? 0 : 1);
+	if (!Model.Meshlets.Meshlets.empty()) Count += 4;
+
+	return Count;
+}
+
+// Opens writer with compression, dictionaries and table of contents of flags, Params.context is freed by caller
+struct CMF_Writer* OpenOutput(const char* FileName, const CommandLineFlags& Flags, uint32_t ArrayCount, struct CMF_SaveParams& Params)
+{
+	CMF_Compression Compression = Flags.Compress ? CMF_COMPRESSION_ZSTD : CMF_COMPRESSION_NONE;
+
+	CMF_DefaultSaveParams(&Params);
+	Params.level = Flags.Level;
+	Params.num_threads = Flags.Threads;
+	Params.toc = Flags.Toc ? ArrayCount : 0;
+
+	if (Flags.Dictionaries != nullptr)
+	{
+		Params.context = CMF_CreateContext(Flags.Threads);
 
-		for (int i = 0; i < Count * 3; i++)
+		if (Params.context == nullptr)
 		{
-			Vert.X = Verts[i].Position.X;
-			Vert.Y = Verts[i].Position.Y;
-			Vert.Z = Verts[i].Position.Z;
+			printf("Error: failed to create compression context\n");
+			return nullptr;
+		}
+
+		for (uint32_t Type = CMF_TYPE_POSITION; Type <= CMF_TYPE_INDICES; Type++)
+		{
+			FILE* File = fopen(DictionaryPath(Flags.Dictionaries, Type).c_str(), "rb");
+			if (File == nullptr) continue;
 
-			Vert.U = Verts[i].UV.X;
-			Vert.V = Verts[i].UV.Y;
+			std::vector<uint8_t> Dictionary;
+			uint8_t Buffer[4096];
+
+			for (size_t Read; (Read = fread(Buffer, 1, sizeof(Buffer), File)) > 0;)
+			{
+				Dictionary.insert(Dictionary.end(), Buffer, Buffer + Read);
+			}
 
-			Vert.NX = Verts[i].Normal.X;
-			Vert.NY = Verts[i].Normal.Y;
-			Vert.NZ = Verts[i].Normal.Z;
+			fclose(File);
 
-			Vertices.push_back(Vert);
+			if (CMF_ContextSetDictionary(Params.context, Type, Dictionary.data(), Dictionary.size(), Flags.Level) != 0)
+			{
+				printf("Error: invalid dictionary '%s'\n", DictionaryPath(Flags.Dictionaries, Type).c_str());
+			}
 		}
+	}
 
-		free(Verts);
+	// Arrays are written by chunks, so the model is never duplicated in memory
+	struct CMF_Writer* Writer = CMF_OpenWriter(FileName, Compression, &Params);
 
-		break;
+	if (Writer == nullptr)
+	{
+		CMF_FreeContext(Params.context);
+		Params.context = nullptr;
+	}
+
+	return Writer;
+}
+
+bool Save(const char* FileName, const Mesh& Model, CommandLineFlags Flags)
+{
+	const std::vector<Vertex>& Vertices = Model.Vertices;
+
+	struct CMF_SaveParams Params;
+	struct CMF_Writer* Writer = OpenOutput(FileName, Flags, CountArrays(Model, Flags), Params);
+
+	if (Writer == nullptr) return false;
+
+	const uint32_t Types[3] = { CMF_TYPE_POSITION, CMF_TYPE_TEXCOORD, CMF_TYPE_NORMAL };
+	const uint32_t Components[3] = { 3, 2, 3 };
+	const uint32_t Formats[3] =
+	{
+		Flags.QuantizePositions ? (uint32_t)CMF_FORMAT_USHORT : (uint32_t)CMF_FORMAT_FLOAT,
+		Flags.QuantizeTexcoords ? (uint32_t)CMF_FORMAT_HALF : (uint32_t)CMF_FORMAT_FLOAT,
+		Flags.NormalBits == 8 ? (uint32_t)CMF_FORMAT_BYTE : Flags.NormalBits == 16 ? (uint32_t)CMF_FORMAT_SHORT : (uint32_t)CMF_FORMAT_FLOAT
+	};
+
+	std::vector<float> Chunk(SAVE_CHUNK_SIZE * 3);
+	std::vector<uint8_t> Quantized(SAVE_CHUNK_SIZE * 3 * sizeof(float));
+	float Bounds[6];
+	bool Result = true;
+
+	if (Flags.QuantizePositions)
+	{
+		ComputeBounds(Vertices, Bounds);
+
+		Result = WriteArray(Writer, CMF_TYPE_BOUNDS, CMF_FORMAT_FLOAT, Bounds, sizeof(Bounds));
+	}
+
+	for (int Array = 0; Array < 3 && Result; Array++)
+	{
+		Result = CMF_WriterBeginArray(Writer, Types[Array], Formats[Array]) == 0;
+
+		for (uint64_t Offset = 0; Offset < Vertices.size() && Result; Offset += SAVE_CHUNK_SIZE)
+		{
+			uint64_t Count = std::min<uint64_t>(SAVE_CHUNK_SIZE, Vertices.size() - Offset);
+			PackArray(Types[Array], Vertices.data() + Offset, Count, Chunk.data());
+
+			if (Formats[Array] == CMF_FORMAT_FLOAT)
+			{
+				Result = CMF_WriterAppend(Writer, Chunk.data(), Count * Components[Array] * sizeof(float)) == 0;
+			}
+			else
+			{
+				uint64_t Size = QuantizeArray(Types[Array], Formats[Array], Chunk.data(), Count, Bounds, Quantized.data());
+				Result = CMF_WriterAppend(Writer, Quantized.data(), Size) == 0;
+			}
+		}
+
+		Result = Result && CMF_WriterEndArray(Writer) == 0;
+	}
+
+	if (!Model.Indices.empty() && Result)
+	{
+		Result = WriteIndices(Writer, CMF_TYPE_INDICES, Model.Indices, Vertices.size());
+
+		for (uint32_t Level = 1; Level <= Model.Lods.size() && Result; Level++)
+		{
+			Result = WriteIndices(Writer, CMF_TYPE_LOD(CMF_TYPE_INDICES, Level), Model.Lods[Level - 1], Vertices.size());
+		}
+
+		if (!Model.Lods.empty() && Result)
+		{
+			Result = WriteArray(Writer, CMF_TYPE_LOD_ERRORS, CMF_FORMAT_FLOAT, Model.LodErrors.data(), Model.LodErrors.size() * sizeof(float));
+		}
+	}
+
+	const MeshletData& Meshlets = Model.Meshlets;
+
+	// Bytes of triangles are written last, so arrays of floats and uints after them stay aligned by 4 in mapped files
+	if (!Meshlets.Meshlets.empty() && Result)
+	{
+		Result = WriteArray(Writer, CMF_TYPE_MESHLETS, CMF_FORMAT_UINT, Meshlets.Meshlets.data(), Meshlets.Meshlets.size() * sizeof(CMF_Meshlet))
+		      && WriteArray(Writer, CMF_TYPE_MESHLET_VERTICES, CMF_FORMAT_UINT, Meshlets.Vertices.data(), Meshlets.Vertices.size() * sizeof(uint32_t))
+		      && WriteArray(Writer, CMF_TYPE_MESHLET_BOUNDS, CMF_FORMAT_FLOAT, Meshlets.Bounds.data(), Meshlets.Bounds.size() * sizeof(CMF_MeshletBounds))
+		      && WriteArray(Writer, CMF_TYPE_MESHLET_TRIANGLES, CMF_FORMAT_UBYTE, Meshlets.Triangles.data(), Meshlets.Triangles.size());
+	}
+
+	Result = CMF_CloseWriter(Writer, Vertices.size()) == 0 && Result;
+	CMF_FreeContext(Params.context);
+
+	return Result;
+}
+
+/*
+* Writes float accessor of glTF into array. Packed accessor is written right from mapping,
+* interleaved one is unpacked by chunks and missing one is written as zeros, as Save does.
+*/
+bool WriteAccessor(struct CMF_Writer* Writer, uint32_t Type, const GltfAccessor& Accessor, uint64_t Count, uint32_t ElementSize)
+{
+	if (Accessor.Count != 0 && Accessor.Stride == ElementSize)
+	{
+		return WriteArray(Writer, Type, CMF_FORMAT_FLOAT, Accessor.Data, Count * ElementSize);
+	}
+
+	std::vector<uint8_t> Chunk(std::min<uint64_t>(SAVE_CHUNK_SIZE, Count) * ElementSize, 0);
+	bool Result = CMF_WriterBeginArray(Writer, Type, CMF_FORMAT_FLOAT) == 0;
+
+	for (uint64_t Offset = 0; Offset < Count && Result; Offset += SAVE_CHUNK_SIZE)
+	{
+		uint64_t ChunkCount = std::min<uint64_t>(SAVE_CHUNK_SIZE, Count - Offset);
+
+		if (Accessor.Count != 0)
+		{
+			// Stride after the last element may be out of buffer, so it is copied alone
+			uint64_t Unpacked = Offset + ChunkCount == Count ? ChunkCount - 1 : ChunkCount;
+			struct CMF_InfoArray Array = { Type, CMF_FORMAT_FLOAT, (uint32_t)(Unpacked * ElementSize), Chunk.data() };
+
+			CMF_Deinterleave(Accessor.Data + Offset * Accessor.Stride, Accessor.Stride, (uint32_t)Unpacked, &Array, 1);
+			if (Unpacked < ChunkCount) memcpy(Chunk.data() + Unpacked * ElementSize, Accessor.Data + (Count - 1) * Accessor.Stride, ElementSize);
+		}
+
+		Result = CMF_WriterAppend(Writer, Chunk.data(), ChunkCount * ElementSize) == 0;
+	}
+
+	return Result && CMF_WriterEndArray(Writer) == 0;
+}
+
+// Writes single primitive of glTF without conversion into vertices, indices keep their format
+bool SaveGLB(const char* FileName, const GltfModel& Model, const CommandLineFlags& Flags)
+{
+	const GltfPrimitive& Primitive = Model.Primitives[0];
+	const GltfAccessor& Indices = Primitive.Indices;
+	uint64_t Count = Primitive.Positions.Count;
+
+	struct CMF_SaveParams Params;
+	struct CMF_Writer* Writer = OpenOutput(FileName, Flags, Indices.Count != 0 ? 4 : 3, Params);
+
+	if (Writer == nullptr) return false;
+
+	bool Result = WriteAccessor(Writer, CMF_TYPE_POSITION, Primitive.Positions, Count, 3 * sizeof(float))
+	           && WriteAccessor(Writer, CMF_TYPE_TEXCOORD, Primitive.Texcoords, Count, 2 * sizeof(float))
+	           && WriteAccessor(Writer, CMF_TYPE_NORMAL, Primitive.Normals, Count, 3 * sizeof(float));
+
+	if (Indices.Count != 0 && Result)
+	{
+		uint32_t Format = Indices.ComponentType == GLTF_UNSIGNED_BYTE  ? (uint32_t)CMF_FORMAT_UBYTE :
+		                  Indices.ComponentType == GLTF_UNSIGNED_SHORT ? (uint32_t)CMF_FORMAT_USHORT : (uint32_t)CMF_FORMAT_UINT;
+
+		Result = WriteArray(Writer, CMF_TYPE_INDICES, Format, Indices.Data, Indices.Count * Indices.ElementSize);
+	}
+
+	Result = CMF_CloseWriter(Writer, Count) == 0 && Result;
+	CMF_FreeContext(Params.context);
+
+	return Result;
+}
+
+// Appends formatted message to log of job, so messages of parallel jobs are not mixed
+void Print(std::string& Log, const char* Format, ...)
+{
+	char Buffer[1024];
+	va_list Args;
+	va_start(Args, Format);
+	vsnprintf(Buffer, sizeof(Buffer), Format, Args);
+	va_end(Args);
+
+	Log += Buffer;
+}
+
+/*
+* Converts one input into output with processing selected by flags,
+* all state of conversion is local, so several conversions may run in parallel.
+*/
+bool Convert(const char* Input, const char* Output, const CommandLineFlags& Flags, std::string& Log)
+{
+	Mesh Model;
+	std::vector<Vertex>& Vertices = Model.Vertices;
+	std::vector<uint32_t>& Indices = Model.Indices;
+
+	bool Processed = Flags.Index || Flags.Optimize || Flags.Meshlets || Flags.Lods > 0 ||
+	                 Flags.QuantizePositions || Flags.QuantizeTexcoords || Flags.NormalBits != 0;
+
+	// Without processing, accessors of glTF are written into arrays right from its mapping
+	if (!Processed && GetFileType(Input) == GLB)
+	{
+		GltfModel Gltf;
+
+		if (OpenGLB(Input, Gltf) && GltfIsDirect(Gltf))
+		{
+			bool Result = SaveGLB(Output, Gltf, Flags);
+			if (!Result) Print(Log, "Error: failed to save file '%s'\n", Output);
+
+			CloseGLB(Gltf);
+			return Result;
+		}
+
+		CloseGLB(Gltf);
+	}
+
+	if (!Load(Input, Model, Flags.Threads))
+	{
+		Print(Log, "Error: failed to load file '%s'\n", Input);
+		return false;
+	}
+
+	if (Flags.Index)
+	{
+		uint64_t Count = Vertices.size();
+
+		// Vertices of indexed model may still be equal, they are welded and indices are remapped
+		if (Indices.empty()) WeldVertices(Vertices, Indices);
+		else
+		{
+			std::vector<uint32_t> Remap;
+			WeldVertices(Vertices, Remap);
+			RemapIndices(Indices, Remap);
+		}
+
+		Print(Log, "Welded %lu vertices into %lu\n", (unsigned long)Count, (unsigned long)Vertices.size());
+	}
+
+	if (Flags.Lods > 0)
+	{
+		GenerateLods(Vertices, Indices, Flags.Lods, Model.Lods, Model.LodErrors);
+
+		for (size_t Level = 0; Level < Model.Lods.size(); Level++)
+		{
+			Print(Log, "LOD %lu: %lu triangles, error %g\n", (unsigned long)Level + 1, (unsigned long)Model.Lods[Level].size() / 3, Model.LodErrors[Level + 1]);
+		}
+	}
+
+	if (Flags.Optimize)
+	{
+		float Before = AverageCacheMissRatio(Indices, Vertices.size());
+
+		OptimizeVertexCache(Indices, Vertices.size());
+		OptimizeOverdraw(Indices, Vertices);
+
+		for (auto& Lod : Model.Lods)
+		{
+			OptimizeVertexCache(Lod, Vertices.size());
+			OptimizeOverdraw(Lod, Vertices);
+		}
+
+		std::vector<uint32_t> Remap = OptimizeVertexFetch(Indices, Vertices);
+		for (auto& Lod : Model.Lods) RemapIndices(Lod, Remap);
+
+		Print(Log, "ACMR %.3f -> %.3f\n", Before, AverageCacheMissRatio(Indices, Vertices.size()));
+	}
+
+	if (Flags.Meshlets)
+	{
+		BuildMeshlets(Indices, Vertices, Model.Meshlets);
+		Print(Log, "Built %lu meshlets\n", (unsigned long)Model.Meshlets.Meshlets.size());
 	}
+
+	if (!Save(Output, Model, Flags))
+	{
+		Print(Log, "Error: failed to save file '%s'\n", Output);
+		return false;
 	}
 
 	return true;
 }
 
-bool Save(const char* FileName, CommandLineFlags Flags)
+/*
+* Trains ZSTD dictionaries of positions, texcoords and normals on input files
+* and writes them into directory, which may be passed later with --dictionaries.
+*/
+bool Train(const char* Directory, int Count, char** Inputs, bool Quiet)
 {
-	uint32_t Count = Vertices.size();
-	CMF_Compression Compression = Flags.Compress ? CMF_COMPRESSION_ZSTD : CMF_COMPRESSION_NONE;
+	const uint32_t Types[3] = { CMF_TYPE_POSITION, CMF_TYPE_TEXCOORD, CMF_TYPE_NORMAL };
+	std::vector<uint8_t> Samples[3];
+	std::vector<size_t> SampleSizes[3];
+
+	for (int i = 0; i < Count; i++)
+	{
+		Mesh Model;
+
+		if (!Load(Inputs[i], Model))
+		{
+			printf("Error: failed to load file '%s'\n", Inputs[i]);
+			return false;
+		}
 
-	struct CMF_Info Info;
-	Info.compression = Compression;
-	Info.num_vertices = Vertices.size();
-	Info.num_arrays = 3;
-	Info.arrays = new CMF_InfoArray[Info.num_arrays];
+		std::vector<float> Arrays[3];
 
-	float* Positions = new float[Vertices.size() * 3];
-	float* Texcoords = new float[Vertices.size() * 2];
-	float* Normals   = new float[Vertices.size() * 3];
+		for (const auto& Vert : Model.Vertices)
+		{
+			Arrays[0].insert(Arrays[0].end(), { Vert.X, Vert.Y, Vert.Z });
+			Arrays[1].insert(Arrays[1].end(), { Vert.U, Vert.V });
+			Arrays[2].insert(Arrays[2].end(), { Vert.NX, Vert.NY, Vert.NZ });
+		}
+
+		for (int Type = 0; Type < 3; Type++)
+		{
+			const uint8_t* Data = (const uint8_t*)Arrays[Type].data();
+			size_t Size = Arrays[Type].size() * sizeof(float);
 
-	for (auto& Vert : Vertices)
+			for (size_t Offset = 0; Offset < Size; Offset += DICTIONARY_SAMPLE_SIZE)
+			{
+				size_t SampleSize = std::min<size_t>(Size - Offset, DICTIONARY_SAMPLE_SIZE);
+				Samples[Type].insert(Samples[Type].end(), Data + Offset, Data + Offset + SampleSize);
+				SampleSizes[Type].push_back(SampleSize);
+			}
+		}
+	}
+
+	for (int Type = 0; Type < 3; Type++)
+	{
+		std::vector<uint8_t> Dictionary(DICTIONARY_SIZE);
+		size_t Size = ZDICT_trainFromBuffer(Dictionary.data(), Dictionary.size(), Samples[Type].data(), SampleSizes[Type].data(), SampleSizes[Type].size());
+
+		if (ZDICT_isError(Size))
+		{
+			printf("Error: failed to train %s dictionary: %s\n", DictionaryName(Types[Type]), ZDICT_getErrorName(Size));
+			return false;
+		}
+
+		std::string Path = DictionaryPath(Directory, Types[Type]);
+		FILE* File = fopen(Path.c_str(), "wb");
+
+		if (File == nullptr)
+		{
+			printf("Error: failed to save file '%s'\n", Path.c_str());
+			return false;
+		}
+
+		fwrite(Dictionary.data(), Size, 1, File);
+		fclose(File);
+
+		if (!Quiet) printf("%s: %zu bytes\n", Path.c_str(), Size);
+	}
+
+	return true;
+}
+
+/*
+* Writes input files into pack, every file is found in pack by its path relative to current directory.
+* Inputs outside of current directory are rejected, so unpacking never writes outside of its directory.
+*/
+bool Pack(const char* Output, int Count, char** Inputs, bool Quiet)
+{
+	std::vector<CMF_PackFile> Files(Count);
+
+	for (int i = 0; i < Count; i++)
+	{
+		const char* Name = Inputs[i];
+		while (Name[0] == '.' && Name[1] == '/') Name += 2;
+
+		if (!CMF_IsSafePackName(Name))
+		{
+			printf("Error: input '%s' is not a relative path inside current directory\n", Inputs[i]);
+			return false;
+		}
+
+		Files[i].name = Name;
+		Files[i].path = Inputs[i];
+	}
+
+	if (CMF_SavePack(Output, Files.data(), Count) != 0)
+	{
+		printf("Error: failed to write pack '%s', inputs must exist and have unique names\n", Output);
+		return false;
+	}
+
+	if (!Quiet) printf("Packed %d files into %s\n", Count, Output);
+	return true;
+}
+
+// Creates every missing parent directory of path
+void MakeParentDirectories(const std::string& Path)
+{
+	for (size_t i = Path.find('/', 1); i != std::string::npos; i = Path.find('/', i + 1))
+	{
+		std::string Directory = Path.substr(0, i);
+#ifdef _WIN32
+		_mkdir(Directory.c_str());
+#else
+		mkdir(Directory.c_str(), 0755);
+#endif
+	}
+}
+
+/*
+* Writes every file of pack into directory under its name. Pack may come from anywhere,
+* so unpacking stops at the first name which would be written outside of directory.
+*/
+bool Unpack(const char* Input, const char* Directory, bool Quiet)
+{
+	CMF_Pack Pack;
+
+	if (CMF_OpenPack(Input, &Pack) != 0)
+	{
+		printf("Error: failed to open pack '%s'\n", Input);
+		return false;
+	}
+
+	bool Result = true;
+
+	for (uint32_t i = 0; i < Pack.header.num_entries && Result; i++)
+	{
+		uint64_t Size = 0;
+		const char* Name = CMF_PackFileName(&Pack, i);
+		const void* Data = CMF_PackFileData(&Pack, i, &Size);
+
+		if (Name == nullptr || Data == nullptr)
+		{
+			printf("Error: pack '%s' is corrupted\n", Input);
+			Result = false;
+			break;
+		}
+
+		if (!CMF_IsSafePackName(Name))
+		{
+			printf("Error: pack '%s' has unsafe file name '%s'\n", Input, Name);
+			Result = false;
+			break;
+		}
+
+		std::string Path = std::string(Directory) + "/" + Name;
+		MakeParentDirectories(Path);
+
+		FILE* File = fopen(Path.c_str(), "wb");
+
+		if (File == nullptr || (Size != 0 && fwrite(Data, Size, 1, File) != 1))
+		{
+			printf("Error: failed to save file '%s'\n", Path.c_str());
+			Result = false;
+		}
+
+		if (File != nullptr) fclose(File);
+	}
+
+	if (Result && !Quiet) printf("Unpacked %u files into %s\n", Pack.header.num_entries, Directory);
+
+	CMF_ClosePack(&Pack);
+	return Result;
+}
+
+// Input and output of one conversion of batch
+struct BatchJob
+{
+	std::string Input;
+	std::string Output;
+};
+
+/*
+* Reads jobs of manifest, every line has input and output paths separated by whitespace,
+* empty lines and lines starting with # are skipped.
+*/
+bool ReadManifest(const char* FileName, std::vector<BatchJob>& Jobs)
+{
+	FILE* File = fopen(FileName, "r");
+	if (File == nullptr) return false;
+
+	char Line[4096];
+	bool Result = true;
+
+	while (fgets(Line, sizeof(Line), File) != nullptr && Result)
 	{
-		*Positions++ = Vert.X;
-		*Positions++ = Vert.Y;
-		*Positions++ = Vert.Z;
+		char Input[2048], Output[2048];
+		int Count = sscanf(Line, "%2047s %2047s", Input, Output);
+
+		if (Count <= 0 || Input[0] == '#') continue;
+
+		if (Count != 2)
+		{
+			printf("Error: line of manifest has no output: %s", Line);
+			Result = false;
+		}
+		else Jobs.push_back({ Input, Output });
+	}
 
-		*Texcoords++ = Vert.U;
-		*Texcoords++ = Vert.V;
+	fclose(File);
+	return Result;
+}
+
+// Output of file of input directory has the same relative path in output directory and .cmf extension
+std::string BatchOutputPath(const char* OutputDirectory, const std::string& Relative)
+{
+	size_t Slash = Relative.rfind('/');
+	size_t Dot = Relative.rfind('.');
+	bool HasExtension = Dot != std::string::npos && (Slash == std::string::npos || Dot > Slash);
 
-		*Normals++ = Vert.NX;
-		*Normals++ = Vert.NY;
-		*Normals++ = Vert.NZ;
+	return std::string(OutputDirectory) + "/" + (HasExtension ? Relative.substr(0, Dot) : Relative) + ".cmf";
+}
+
+/*
+* Converts every model of input directory into output directory or every job of manifest
+* if OutputDirectory is null. Files are converted in parallel on Flags.Threads threads with
+* single-threaded compression, outputs which are not older than inputs are skipped.
+*/
+bool Batch(const char* Input, const char* OutputDirectory, const CommandLineFlags& Flags)
+{
+	std::vector<BatchJob> Jobs;
+
+	if (OutputDirectory != nullptr)
+	{
+		std::vector<std::string> Files;
+		ListFiles(Input, "", Files);
+
+		for (const auto& File : Files) Jobs.push_back({ std::string(Input) + "/" + File, BatchOutputPath(OutputDirectory, File) });
+	}
+	else if (!ReadManifest(Input, Jobs))
+	{
+		printf("Error: failed to read manifest '%s'\n", Input);
+		return false;
 	}
 
-	Positions -= Vertices.size() * 3;
-	Texcoords -= Vertices.size() * 2;
-	Normals   -= Vertices.size() * 3;
+	CommandLineFlags JobFlags = Flags;
+	JobFlags.Threads = 1;
 
-	Info.arrays[0].type = CMF_TYPE_POSITION;
-	Info.arrays[1].type = CMF_TYPE_TEXCOORD;
-	Info.arrays[2].type = CMF_TYPE_NORMAL;
+	std::mutex Mutex;
+	std::vector<std::string> Errors;
+	uint64_t Converted = 0, Skipped = 0, Ignored = 0;
 
-	Info.arrays[0].format = CMF_FORMAT_FLOAT;
-	Info.arrays[1].format = CMF_FORMAT_FLOAT;
-	Info.arrays[2].format = CMF_FORMAT_FLOAT;
+	// Reporter prints the last line of progress when it is destroyed, before errors
+	{
+		ProgressReporter Progress(Jobs.size(), Flags.Quiet);
 
-	Info.arrays[0].size = Vertices.size() * 3 * sizeof(float);
-	Info.arrays[1].size = Vertices.size() * 2 * sizeof(float);
-	Info.arrays[2].size = Vertices.size() * 3 * sizeof(float);
+		RunJobs(Jobs.size(), Flags.Threads, [&](uint64_t Index)
+		{
+			const BatchJob& Job = Jobs[Index];
+			int64_t OutputTime = FileTime(Job.Output);
+			std::string Log;
+			int Status = 0;
+
+			if (GetFileType(Job.Input.c_str()) == Undefined) Status = 1;
+			else if (OutputTime != -1 && OutputTime >= FileTime(Job.Input)) Status = 2;
+			else
+			{
+				MakeParentDirectories(Job.Output);
+				Status = Convert(Job.Input.c_str(), Job.Output.c_str(), JobFlags, Log) ? 3 : 4;
+			}
 
-	Info.arrays[0].data = Positions;
-	Info.arrays[1].data = Texcoords;
-	Info.arrays[2].data = Normals;
+			Progress.Add(1);
+			std::lock_guard<std::mutex> Lock(Mutex);
+
+			switch (Status)
+			{
+			case 1: Ignored++; break;
+			case 2: Skipped++; break;
+			case 3: Converted++; break;
+			case 4: Errors.push_back(Log); break;
+			}
+		});
+	}
 
-	int Code = CMF_Save2(FileName, &Info);
+	for (const auto& Error : Errors) printf("%s", Error.c_str());
 
-	delete[] Positions;
-	delete[] Texcoords;
-	delete[] Normals;
-	delete[] Info.arrays;
+	if (!Flags.Quiet)
+	{
+		printf("Converted %lu, up to date %lu, not models %lu, failed %lu\n",
+		       (unsigned long)Converted, (unsigned long)Skipped, (unsigned long)Ignored, (unsigned long)Errors.size());
+	}
 
-	return Code == 0;
+	return Errors.empty();
 }
 
 void PrintUsing()
 {
 	printf("Using\n");
-	printf("cmf [input] [output] [flags]\n\n");
+	printf("cmf [input] [output] [flags]\n");
+	printf("cmf train [directory] [inputs...]\n");
+	printf("cmf pack [output] [inputs...]\n");
+	printf("cmf unpack [input] [directory]\n");
+	printf("cmf batch [input directory] [output directory] [flags]\n");
+	printf("cmf batch [manifest] [flags]\n\n");
 	printf("Flags\n");
 	printf("-h, --help         print this message\n");
+	printf("-q, --quiet        print only errors\n");
 	printf("-c, --compress     enable compression for output file\n");
+	printf("-l, --level [N]    compression level, %d by default\n", CMF_DEFAULT_COMPRESSION_LEVEL);
+	printf("-j, --threads [N]  count of compression threads or of batch workers, all hardware threads by default\n");
+	printf("-d, --dictionaries [directory]\n");
+	printf("                   compress arrays with dictionaries trained by «cmf train»\n");
+	printf("-i, --index        weld identical vertices and write indices\n");
+	printf("-o, --optimize     reorder indexed triangles and vertices for GPU caches, implies --index\n");
+	printf("-m, --meshlets     build meshlets of %d vertices and %d triangles with bounds for culling, implies --index\n", CMF_MESHLET_MAX_VERTICES, CMF_MESHLET_MAX_TRIANGLES);
+	printf("-L, --lods [N]     generate N levels of detail, every one has a half of triangles, implies --index\n");
+	printf("-T, --toc          write table of contents with offsets of arrays\n");
+	printf("-qp, --quantize-positions\n");
+	printf("                   write positions as 16-bit values normalized against bounding box\n");
+	printf("-qt, --quantize-texcoords\n");
+	printf("                   write texture coordinates as half floats\n");
+	printf("-qn, --quantize-normals [8|16]\n");
+	printf("                   write normals as octahedral-encoded 2 components of given bits\n");
 	printf("-v, --vertices     enable writing vertices in output file\n");
 	printf("-t, --texcoords    enable writing texture coordinates in output file\n");
 	printf("-n, --normals      enable writing normals in output file\n");
 }
 
-CommandLineFlags CheckFlags(int argc, char** argv)
+// Flags start at argument First, arguments before it are positional
+CommandLineFlags CheckFlags(int argc, char** argv, int First = 1)
 {
 	CommandLineFlags Flags;
 
-	for (int i = 1; i < argc; i++)
+	for (int i = First; i < argc; i++)
 	{
 		if (memcmp(argv[i], "-h", 2) == 0 || memcmp(argv[i], "--help", 6) == 0)
 		{
-			if (argc >= 3)
+			// Only output of single conversion is probed, in batch argv[2] is an input
+			if (argc >= 3 && First == 1)
 			{
 				if (argv[2][0] != '-' && FileMayBeCreated(argv[2]))
 				{
@@ -200,6 +904,99 @@ CommandLineFlags CheckFlags(int argc, char** argv)
 			Flags.Compress = true;
 		}
 		else
+		if (memcmp(argv[i], "-l", 2) == 0 || memcmp(argv[i], "--level", 7) == 0)
+		{
+			if (i + 1 >= argc)
+			{
+				printf("Error: Compression level is not specified\n");
+				exit(1);
+			}
+
+			Flags.Level = atoi(argv[++i]);
+		}
+		else
+		if (memcmp(argv[i], "-j", 2) == 0 || memcmp(argv[i], "--threads", 9) == 0)
+		{
+			if (i + 1 >= argc)
+			{
+				printf("Error: Count of threads is not specified\n");
+				exit(1);
+			}
+
+			Flags.Threads = atoi(argv[++i]);
+		}
+		else
+		if (memcmp(argv[i], "-d", 2) == 0 || memcmp(argv[i], "--dictionaries", 14) == 0)
+		{
+			if (i + 1 >= argc)
+			{
+				printf("Error: Directory of dictionaries is not specified\n");
+				exit(1);
+			}
+
+			Flags.Dictionaries = argv[++i];
+		}
+		else
+		if (memcmp(argv[i], "-T", 2) == 0 || memcmp(argv[i], "--toc", 5) == 0)
+		{
+			Flags.Toc = true;
+		}
+		else
+		if (memcmp(argv[i], "-i", 2) == 0 || memcmp(argv[i], "--index", 7) == 0)
+		{
+			Flags.Index = true;
+		}
+		else
+		if (memcmp(argv[i], "-o", 2) == 0 || memcmp(argv[i], "--optimize", 10) == 0)
+		{
+			Flags.Index = true;
+			Flags.Optimize = true;
+		}
+		else
+		if (memcmp(argv[i], "-m", 2) == 0 || memcmp(argv[i], "--meshlets", 10) == 0)
+		{
+			Flags.Index = true;
+			Flags.Meshlets = true;
+		}
+		else
+		if (memcmp(argv[i], "-L", 2) == 0 || memcmp(argv[i], "--lods", 6) == 0)
+		{
+			if (i + 1 >= argc)
+			{
+				printf("Error: Count of levels of detail is not specified\n");
+				exit(1);
+			}
+
+			Flags.Index = true;
+			Flags.Lods = atoi(argv[++i]);
+		}
+		else
+		if (memcmp(argv[i], "-qp", 3) == 0 || memcmp(argv[i], "--quantize-positions", 20) == 0)
+		{
+			Flags.QuantizePositions = true;
+		}
+		else
+		if (memcmp(argv[i], "-qt", 3) == 0 || memcmp(argv[i], "--quantize-texcoords", 20) == 0)
+		{
+			Flags.QuantizeTexcoords = true;
+		}
+		else
+		if (memcmp(argv[i], "-qn", 3) == 0 || memcmp(argv[i], "--quantize-normals", 18) == 0)
+		{
+			if (i + 1 >= argc || (atoi(argv[i + 1]) != 8 && atoi(argv[i + 1]) != 16))
+			{
+				printf("Error: Bits of normals must be 8 or 16\n");
+				exit(1);
+			}
+
+			Flags.NormalBits = atoi(argv[++i]);
+		}
+		else
+		if (strcmp(argv[i], "-q") == 0 || strcmp(argv[i], "--quiet") == 0)
+		{
+			Flags.Quiet = true;
+		}
+		else
 		if (memcmp(argv[i], "-v", 2) == 0 || memcmp(argv[i], "--vertices", 10) == 0)
 		{
 			Flags.VerticesWrite = true;
@@ -235,10 +1032,98 @@ CommandLineFlags CheckFlags(int argc, char** argv)
 	return Flags;
 }
 
+// Quiet flag is looked up before commands are parsed, so even the title is not printed
+bool IsQuiet(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-q") == 0 || strcmp(argv[i], "--quiet") == 0) return true;
+	}
+
+	return false;
+}
+
+// Arguments without quiet flag, so it may stand anywhere, even before positional arguments of commands
+std::vector<char*> PositionalArguments(int argc, char** argv)
+{
+	std::vector<char*> Arguments;
+
+	for (int i = 0; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-q") != 0 && strcmp(argv[i], "--quiet") != 0) Arguments.push_back(argv[i]);
+	}
+
+	return Arguments;
+}
+
 int main(int argc, char** argv)
 {
-	printf("Columbus Model Format Util\n\n");
-	CommandLineFlags Flags = CheckFlags(argc, argv);
+	bool Quiet = IsQuiet(argc, argv);
+	if (!Quiet) printf("Columbus Model Format Util\n\n");
+
+	std::vector<char*> Arguments = PositionalArguments(argc, argv);
+	char** Args = Arguments.data();
+	int Count = (int)Arguments.size();
+
+	if (Count >= 2 && strcmp(Args[1], "train") == 0)
+	{
+		if (Count < 4)
+		{
+			PrintUsing();
+			return 1;
+		}
+
+		return Train(Args[2], Count - 3, Args + 3, Quiet) ? 0 : 1;
+	}
+
+	if (Count >= 2 && strcmp(Args[1], "pack") == 0)
+	{
+		if (Count < 3)
+		{
+			PrintUsing();
+			return 1;
+		}
+
+		return Pack(Args[2], Count - 3, Args + 3, Quiet) ? 0 : 1;
+	}
+
+	if (Count >= 2 && strcmp(Args[1], "unpack") == 0)
+	{
+		if (Count < 4)
+		{
+			PrintUsing();
+			return 1;
+		}
+
+		return Unpack(Args[2], Args[3], Quiet) ? 0 : 1;
+	}
+
+	if (Count >= 2 && strcmp(Args[1], "batch") == 0)
+	{
+		for (int i = 2; i < Count; i++)
+		{
+			if (strcmp(Args[i], "-h") == 0 || strcmp(Args[i], "--help") == 0)
+			{
+				PrintUsing();
+				return 0;
+			}
+		}
+
+		int First = Count >= 3 && IsDirectory(Args[2]) ? 4 : 3;
+
+		if (Count < First)
+		{
+			PrintUsing();
+			return 1;
+		}
+
+		CommandLineFlags Flags = CheckFlags(Count, Args, First);
+		Flags.Quiet = Quiet;
+		return Batch(Args[2], First == 4 ? Args[3] : nullptr, Flags) ? 0 : 1;
+	}
+
+	CommandLineFlags Flags = CheckFlags(Count, Args);
+	Flags.Quiet = Quiet;
 
 	if (Flags.Help)
 	{
@@ -246,22 +1131,18 @@ int main(int argc, char** argv)
 		return 0;
 	}
 
-	if (argc < 3)
+	if (Count < 3)
 	{
 		PrintUsing();
 		return 1;
 	}
 
-	if (!Load(argv[1]))
-	{
-		printf("Error: failed to load file '%s'\n", argv[1]);
-		printf("Use -h or --help for help\n");
-		return 1;
-	}
+	std::string Log;
+	bool Result = Convert(Args[1], Args[2], Flags, Log);
+	if (!Result || !Flags.Quiet) printf("%s", Log.c_str());
 
-	if (!Save(argv[2], Flags))
+	if (!Result)
 	{
-		printf("Error: failed to save file '%s'\n", argv[2]);
 		printf("Use -h or --help for help\n");
 		return 1;
 	}
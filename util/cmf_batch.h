@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <sys/stat.h>
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <dirent.h>
+#endif
+
+// Range of jobs of one worker, owner takes jobs from front and thieves take them from back
+struct JobRange
+{
+	std::mutex Mutex;
+	uint64_t Begin = 0;
+	uint64_t End = 0;
+};
+
+static bool TakeJob(JobRange& Range, uint64_t& Job)
+{
+	std::lock_guard<std::mutex> Lock(Range.Mutex);
+	if (Range.Begin == Range.End) return false;
+
+	Job = Range.Begin++;
+	return true;
+}
+
+// Moves the back half of the largest range of other workers into range of thief
+static bool StealJobs(std::vector<JobRange>& Ranges, uint32_t Thief)
+{
+	uint32_t Victim = Thief;
+	uint64_t Largest = 0;
+
+	for (uint32_t Worker = 0; Worker < Ranges.size(); Worker++)
+	{
+		std::lock_guard<std::mutex> Lock(Ranges[Worker].Mutex);
+		uint64_t Size = Ranges[Worker].End - Ranges[Worker].Begin;
+		if (Worker != Thief && Size > Largest) { Largest = Size; Victim = Worker; }
+	}
+
+	if (Victim == Thief) return false;
+
+	uint64_t Begin, End;
+
+	{
+		std::lock_guard<std::mutex> Lock(Ranges[Victim].Mutex);
+		End = Ranges[Victim].End;
+		Begin = End - (End - Ranges[Victim].Begin + 1) / 2;
+		Ranges[Victim].End = Begin;
+	}
+
+	// Only one lock is held at once, range may have been taken since it was measured, then thief looks again
+	std::lock_guard<std::mutex> Lock(Ranges[Thief].Mutex);
+	Ranges[Thief].Begin = Begin;
+	Ranges[Thief].End = End;
+	return true;
+}
+
+/*
+* Runs Job for every index in [0; Count) on Threads threads. Every worker starts with its own
+* contiguous range of jobs, a worker which ran out of jobs steals a half of the largest range,
+* so a few slow jobs do not leave other threads idle.
+*/
+void RunJobs(uint64_t Count, uint32_t Threads, const std::function<void(uint64_t Job)>& Job)
+{
+	if (Threads == 0) Threads = std::max(1u, std::thread::hardware_concurrency());
+	if (Threads > Count) Threads = (uint32_t)std::max<uint64_t>(Count, 1);
+
+	std::vector<JobRange> Ranges(Threads);
+
+	for (uint32_t Worker = 0; Worker < Threads; Worker++)
+	{
+		Ranges[Worker].Begin = Count * Worker / Threads;
+		Ranges[Worker].End = Count * (Worker + 1) / Threads;
+	}
+
+	auto Work = [&](uint32_t Worker)
+	{
+		uint64_t Index;
+
+		for (;;)
+		{
+			while (TakeJob(Ranges[Worker], Index)) Job(Index);
+			if (!StealJobs(Ranges, Worker)) break;
+		}
+	};
+
+	std::vector<std::thread> Workers;
+
+	for (uint32_t Worker = 1; Worker < Threads; Worker++) Workers.emplace_back(Work, Worker);
+	Work(0);
+
+	for (auto& Worker : Workers) Worker.join();
+}
+
+// Modification time of file or -1 if file does not exist
+int64_t FileTime(const std::string& Path)
+{
+	struct stat Stat;
+	if (stat(Path.c_str(), &Stat) != 0) return -1;
+	return (int64_t)Stat.st_mtime;
+}
+
+bool IsDirectory(const char* Path)
+{
+	struct stat Stat;
+	return stat(Path, &Stat) == 0 && (Stat.st_mode & S_IFMT) == S_IFDIR;
+}
+
+// Collects paths of files in directory and its subdirectories, relative to Root
+void ListFiles(const std::string& Root, const std::string& Relative, std::vector<std::string>& Files)
+{
+	std::string Directory = Relative.empty() ? Root : Root + "/" + Relative;
+	std::vector<std::string> Names;
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA Data;
+	HANDLE Find = FindFirstFileA((Directory + "/*").c_str(), &Data);
+	if (Find == INVALID_HANDLE_VALUE) return;
+
+	do Names.push_back(Data.cFileName);
+	while (FindNextFileA(Find, &Data));
+
+	FindClose(Find);
+#else
+	DIR* Dir = opendir(Directory.c_str());
+	if (Dir == nullptr) return;
+
+	for (struct dirent* Entry = readdir(Dir); Entry != nullptr; Entry = readdir(Dir)) Names.push_back(Entry->d_name);
+
+	closedir(Dir);
+#endif
+
+	// Order of directory entries is not defined, sorted order keeps batches reproducible
+	std::sort(Names.begin(), Names.end());
+
+	for (const auto& Name : Names)
+	{
+		if (Name == "." || Name == "..") continue;
+
+		std::string Path = Relative.empty() ? Name : Relative + "/" + Name;
+
+		if (IsDirectory((Root + "/" + Path).c_str())) ListFiles(Root, Path, Files);
+		else Files.push_back(Path);
+	}
+}
@@ -1,8 +1,16 @@
 #include <cstdio>
 #include <cstdint>
+#include <cstring>
 #include <vector>
+#include <functional>
 #include <zstd.h>
+#ifndef _WIN32
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
 #include "util.h"
+#include "../library/cmf.h"
 
 // CMF structure
 // ____________
@@ -27,331 +35,478 @@
 // |__________|
 
 
-static void ProcessVertices(uint32_t Count, float* VBuffer, float* UBuffer, float* NBuffer, std::vector<Vertex>& Vertices);
-bool LoadCMF(const char* FileName, std::vector<Vertex>& Vertices);
-bool LoadCMFMemory(uint8_t* Data, uint64_t Size, std::vector<Vertex>& Vertices);
-bool SaveCMF(const char* FileName, std::vector<Vertex> Vertices, bool Compressed);
+// Context arguments are optional ZSTD states owned by caller, they are reused between files.
+// Progress is printed by reporter thread.
+bool LoadCMF(const char* FileName, std::vector<Vertex>& Vertices, ZSTD_DCtx* Context = nullptr, bool Progress = false);
+bool LoadCMFMemory(const uint8_t* Data, uint64_t Size, std::vector<Vertex>& Vertices, ZSTD_DCtx* Context = nullptr, ProgressReporter* Progress = nullptr);
+bool SaveCMF(const char* FileName, const std::vector<Vertex>& Vertices, bool Compressed, ZSTD_CCtx* Context = nullptr, bool Progress = false);
 
-void  ProcessVertices(uint32_t Count, float* VBuffer, float* UBuffer, float* NBuffer, std::vector<Vertex>& Vertices)
+// Calls Callback for every ChunkSize vertices of file, loading stops if it returns false
+bool LoadCMFStream(const char* FileName, uint64_t ChunkSize, const std::function<bool(const Vertex*, uint64_t)>& Callback);
+
+#define CMF_V0_HEADER_SIZE 26
+#define CMF_V0_VERTEX_SIZE (8 * sizeof(float))
+#define BULK_BLOCK_SIZE (4 * 1024 * 1024)
+#define INTERLEAVE_CHUNK (1024 * 1024)
+
+/*
+* Writer of whole file by large blocks, small writes are gathered in buffer
+* and large ones go right from data of caller.
+*/
+class BulkWriter
 {
-	if (Count == 0 &&
-	    VBuffer == nullptr &&
-	    UBuffer == nullptr &&
-	    NBuffer == nullptr)
+public:
+	bool Open(const char* FileName)
 	{
-		return;
+		Buffer.resize(BULK_BLOCK_SIZE);
+		Used = 0;
+		Error = false;
+
+#ifdef _WIN32
+		File = fopen(FileName, "wb");
+		return File != nullptr;
+#else
+		Descriptor = open(FileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		return Descriptor != -1;
+#endif
 	}
 
-	Vertex Vert[3];
-
-	uint64_t vcounter = 0;
-	uint64_t ucounter = 0;
-	uint64_t ncounter = 0;
-
-	Vertices.reserve(Count);
-
-	double ProgressOnPolygon = 1.0 / float(Count);
-	double Progress = 0.0f;
-	double Delta = 0.0;
-
-	for (uint32_t i = 0; i < Count; i++)
+	bool Write(const void* Data, uint64_t Size)
 	{
-		for (uint32_t j = 0; j < 3; j++)
-		{
-			Vert[j].X = VBuffer[vcounter++];
-			Vert[j].Y = VBuffer[vcounter++];
-			Vert[j].Z = VBuffer[vcounter++];
+		const uint8_t* Source = (const uint8_t*)Data;
 
-			Vert[j].U = UBuffer[ucounter++];
-			Vert[j].V = UBuffer[ucounter++];
-
-			Vert[j].NX = NBuffer[ncounter++];
-			Vert[j].NY = NBuffer[ncounter++];
-			Vert[j].NZ = NBuffer[ncounter++];
+		while (Size > 0 && !Error)
+		{
+			if (Used == 0 && Size >= BULK_BLOCK_SIZE)
+			{
+				uint64_t Blocks = Size / BULK_BLOCK_SIZE * BULK_BLOCK_SIZE;
+				WriteRaw(Source, Blocks);
+				Source += Blocks;
+				Size -= Blocks;
+				continue;
+			}
 
+			uint64_t Count = std::min<uint64_t>(Size, BULK_BLOCK_SIZE - Used);
+			memcpy(Buffer.data() + Used, Source, Count);
+			Used += Count;
+			Source += Count;
+			Size -= Count;
 
-			Vertices.push_back(Vert[j]);
+			if (Used == BULK_BLOCK_SIZE)
+			{
+				WriteRaw(Buffer.data(), Used);
+				Used = 0;
+			}
 		}
 
-		Delta += ProgressOnPolygon;
+		return !Error;
+	}
+
+	bool Close()
+	{
+#ifdef _WIN32
+		if (File == nullptr) return false;
+		if (Used > 0) WriteRaw(Buffer.data(), Used);
+		if (fclose(File) != 0) Error = true;
+		File = nullptr;
+#else
+		if (Descriptor == -1) return false;
+
+		if (Used > 0) WriteRaw(Buffer.data(), Used);
+		if (close(Descriptor) != 0) Error = true;
+		Descriptor = -1;
+#endif
+
+		Used = 0;
+		return !Error;
+	}
 
-		if (Delta >= 0.01)
+	~BulkWriter()
+	{
+		Close();
+	}
+private:
+	void WriteRaw(const uint8_t* Data, uint64_t Size)
+	{
+#ifdef _WIN32
+		if (fwrite(Data, 1, Size, File) != Size) Error = true;
+#else
+		while (Size > 0 && !Error)
 		{
-			Progress += Delta;
-			Delta = 0.0;
-			PrintProgress(Progress);
+			ssize_t Written = write(Descriptor, Data, std::min<uint64_t>(Size, 0x40000000));
+			if (Written < 0 && errno == EINTR) continue;
+			if (Written <= 0) { Error = true; break; }
+
+			Data += Written;
+			Size -= Written;
 		}
+#endif
 	}
 
-	PrintProgress(1.0);
-	printf("\n\n");
-}
-
-bool LoadCMF(const char* FileName, std::vector<Vertex>& Vertices)
+#ifdef _WIN32
+	FILE* File = nullptr;
+#else
+	int Descriptor = -1;
+#endif
+	std::vector<uint8_t> Buffer;
+	uint64_t Used = 0;
+	bool Error = false;
+};
+
+bool LoadCMF(const char* FileName, std::vector<Vertex>& Vertices, ZSTD_DCtx* Context, bool Progress)
 {
 	FILE* File = fopen(FileName, "rb");
 	if (File == nullptr) return false;
 
-	fseek(File, 0, SEEK_END);
-	uint64_t Size = ftell(File);
-	fseek(File, 0, SEEK_SET);
+	// Failed ftell returns -1, which must not become size of buffer
+	int64_t End = CMF_FSEEK(File, 0, SEEK_END) == 0 ? (int64_t)CMF_FTELL(File) : -1;
+
+	if (End < 0 || CMF_FSEEK(File, 0, SEEK_SET) != 0)
+	{
+		fclose(File);
+		return false;
+	}
+
+	uint64_t Size = (uint64_t)End;
+
+	// File is read by large blocks, so reporter sees how reading goes
+	std::vector<uint8_t> FileBuf(Size);
+	ProgressReporter Reporter(Size * 2, !Progress);
+	bool Result = true;
+
+	for (uint64_t Offset = 0; Offset < Size && Result; Offset += BULK_BLOCK_SIZE)
+	{
+		uint64_t Count = std::min<uint64_t>(BULK_BLOCK_SIZE, Size - Offset);
+		Result = fread(FileBuf.data() + Offset, 1, Count, File) == Count;
+		Reporter.Add(Count);
+	}
 
-	uint8_t* FileBuf = new uint8_t[Size];
-	if (fread(FileBuf, 1, Size, File) != Size) return false;
 	fclose(File);
 
-	bool Result = LoadCMFMemory(FileBuf, Size, Vertices);
-	delete[] FileBuf;
-	return Result;
+	return Result && LoadCMFMemory(FileBuf.data(), Size, Vertices, Context, &Reporter);
 }
 
-bool LoadCMFMemory(uint8_t* Data, uint64_t Size, std::vector<Vertex>& Vertices)
+/*
+* Arrays of positions, texcoords and normals follow each other, in compressed file they are
+* one ZSTD frame. They are interleaved into vertices by chunks with CMF_Interleave.
+*/
+bool LoadCMFMemory(const uint8_t* Data, uint64_t Size, std::vector<Vertex>& Vertices, ZSTD_DCtx* Context, ProgressReporter* Progress)
 {
-	if (Data == nullptr &&
-	    Size == 0)
+	if (Data == nullptr || Size < CMF_V0_HEADER_SIZE || memcmp(Data, "COLUMBUS MODEL FORMAT", 21) != 0)
 	{
 		return false;
 	}
 
-	Data += 21;
 	uint32_t Count = 0;
 	uint8_t Compression = 0;
-	memcpy(&Count, Data, sizeof(uint32_t));      Data += sizeof(uint32_t);
-	memcpy(&Compression, Data, sizeof(uint8_t)); Data += sizeof(uint8_t);
+	memcpy(&Count, Data + 21, sizeof(uint32_t));
+	memcpy(&Compression, Data + 25, sizeof(uint8_t));
 
-	printf("Loading CMF file...\n");
+	uint64_t VertexCount = (uint64_t)Count * 3;
+	uint64_t DataSize = VertexCount * CMF_V0_VERTEX_SIZE;
+	const uint8_t* Payload = Data + CMF_V0_HEADER_SIZE;
+	uint64_t PayloadSize = Size - CMF_V0_HEADER_SIZE;
+	std::vector<uint8_t> Decompressed;
 
-	float* VBuffer = new float[Count * 3 * 3]; //Vertex buffer
-	float* UBuffer = new float[Count * 3 * 2]; //UV buffer
-	float* NBuffer = new float[Count * 3 * 3]; //Normal buffer
-
-	switch (Compression)
+	if (Compression == 0xFF)
 	{
-		case 0x00: //No compression
-		{
-			memcpy(VBuffer, Data, Count * sizeof(float) * 3 * 3); Data += Count * sizeof(float) * 3 * 3;
-			memcpy(UBuffer, Data, Count * sizeof(float) * 3 * 2); Data += Count * sizeof(float) * 3 * 2;
-			memcpy(NBuffer, Data, Count * sizeof(float) * 3 * 3); Data += Count * sizeof(float) * 3 * 3;
-			break;
-		}
+		if (ZSTD_getFrameContentSize(Payload, PayloadSize) != DataSize) return false;
 
-		case 0xFF: //ZSTD compression
-		{
-			uint64_t DecompressedSize = ZSTD_getDecompressedSize(Data, Size - 26);
-			uint8_t* Decompressed = new uint8_t[DecompressedSize];
-			ZSTD_decompress(Decompressed, DecompressedSize, Data, Size - 26);
+		Decompressed.resize(DataSize);
 
-			memcpy(VBuffer, Decompressed, Count * sizeof(float) * 3 * 3); Decompressed += Count * sizeof(float) * 3 * 3;
-			memcpy(UBuffer, Decompressed, Count * sizeof(float) * 3 * 2); Decompressed += Count * sizeof(float) * 3 * 2;
-			memcpy(NBuffer, Decompressed, Count * sizeof(float) * 3 * 3); Decompressed += Count * sizeof(float) * 3 * 3;
+		size_t Result = Context != nullptr
+			? ZSTD_decompressDCtx(Context, Decompressed.data(), DataSize, Payload, PayloadSize)
+			: ZSTD_decompress(Decompressed.data(), DataSize, Payload, PayloadSize);
 
-			Decompressed -= DecompressedSize;
-			delete[] Decompressed;
+		if (ZSTD_isError(Result) || Result != DataSize) return false;
 
-			break;
-		}
+		Payload = Decompressed.data();
+	}
+	else if (Compression != 0x00 || PayloadSize < DataSize)
+	{
+		return false;
 	}
 
-	ProcessVertices(Count, VBuffer, UBuffer, NBuffer, Vertices);
+	const uint8_t* Positions = Payload;
+	const uint8_t* Texcoords = Positions + VertexCount * 3 * sizeof(float);
+	const uint8_t* Normals = Texcoords + VertexCount * 2 * sizeof(float);
 
-	delete[] VBuffer;
-	delete[] UBuffer;
-	delete[] NBuffer;
+	Vertices.resize(VertexCount);
 
-	return true;
-}
+	for (uint64_t Offset = 0; Offset < VertexCount; Offset += INTERLEAVE_CHUNK)
+	{
+		uint64_t Chunk = std::min<uint64_t>(INTERLEAVE_CHUNK, VertexCount - Offset);
 
-bool SaveCMF(const char* FileName, std::vector<Vertex> Vertices, bool Compressed)
-{
-	FILE* File = fopen(FileName, "wb");
+		struct CMF_InfoArray Arrays[3] =
+		{
+			{ CMF_TYPE_POSITION, CMF_FORMAT_FLOAT, (uint32_t)(Chunk * 3 * sizeof(float)), (void*)(Positions + Offset * 3 * sizeof(float)) },
+			{ CMF_TYPE_TEXCOORD, CMF_FORMAT_FLOAT, (uint32_t)(Chunk * 2 * sizeof(float)), (void*)(Texcoords + Offset * 2 * sizeof(float)) },
+			{ CMF_TYPE_NORMAL,   CMF_FORMAT_FLOAT, (uint32_t)(Chunk * 3 * sizeof(float)), (void*)(Normals + Offset * 3 * sizeof(float)) }
+		};
 
-	if (File == nullptr)
-	{
-		return false;
+		if (CMF_Interleave(Arrays, 3, (uint32_t)Chunk, Vertices.data() + Offset, sizeof(Vertex)) != 0) return false;
+		if (Progress != nullptr) Progress->Add(Chunk * Size / VertexCount);
 	}
 
-	uint32_t Count = Vertices.size() / 3;
-	uint8_t Compression = Compressed ? 0xFF : 0x00;
-
-	fwrite("COLUMBUS MODEL FORMAT", 1, 21, File);
-	fwrite(&Count, 1, sizeof(uint32_t), File);
-	fwrite(&Compression, 1, sizeof(uint8_t), File);
+	return true;
+}
 
-	double ProgressPerVertex = 1.0 / Vertices.size() * (3.0 / 8.0);
-	double ProgressPerUV     = 1.0 / Vertices.size() * (2.0 / 8.0);
-	double ProgressPerNormal = 1.0 / Vertices.size() * (3.0 / 8.0);
-	double Progress = 0.0;
-	double Delta = 0.0;
+// Streaming CMF reader
+// Vertices are decoded by chunks into caller memory, so memory doesn't depend on model size.
+// Positions, texcoords and normals lie in separate parts of data, every part is read by its own cursor.
+// In compressed file all parts are in one ZSTD frame, so every cursor decodes the frame from the
+// beginning and throws away data of the previous parts.
 
-	if (!Compressed)
+struct CMFStreamCursor
+{
+	FILE* File = nullptr;
+	ZSTD_DStream* Stream = nullptr;
+	std::vector<uint8_t> Input;
+	std::vector<uint8_t> Scratch;
+	ZSTD_inBuffer InBuffer = { nullptr, 0, 0 };
+	uint64_t Skip = 0;
+
+	bool Open(const char* FileName, uint64_t Offset, bool Compressed, uint64_t SkipSize)
 	{
-		printf("Saving CMF file...\n");
+		File = fopen(FileName, "rb");
+		if (File == nullptr) return false;
+		if (fseek(File, Offset, SEEK_SET) != 0) return false;
 
-		for (const auto& Vert : Vertices)
+		if (Compressed)
 		{
-			float Position[3] = { Vert.X, Vert.Y, Vert.Z };
-			fwrite(Position, 3 * sizeof(float), 1, File);
+			Stream = ZSTD_createDStream();
+			if (Stream == nullptr) return false;
 
-			Delta += ProgressPerVertex;
-
-			if (Delta >= 0.01)
-			{
-				Progress += Delta;
-				Delta = 0.0;
-				PrintProgress(Progress);
-			}
+			Input.resize(ZSTD_DStreamInSize());
+			Scratch.resize(ZSTD_DStreamOutSize());
+			InBuffer = { Input.data(), 0, 0 };
+			Skip = SkipSize;
 		}
 
-		for (const auto& Vert : Vertices)
-		{
-			float UV[2] = { Vert.U, Vert.V };
-			fwrite(UV, 2 * sizeof(float), 1, File);
+		return true;
+	}
 
-			Delta += ProgressPerUV;
+	bool Decode(void* Data, uint64_t Size)
+	{
+		ZSTD_outBuffer OutBuffer = { Data, Size, 0 };
 
-			if (Delta >= 0.01)
+		while (OutBuffer.pos < OutBuffer.size)
+		{
+			if (InBuffer.pos == InBuffer.size)
 			{
-				Progress += Delta;
-				Delta = 0.0;
-				PrintProgress(Progress);
+				InBuffer.size = fread(Input.data(), 1, Input.size(), File);
+				InBuffer.pos = 0;
+				if (InBuffer.size == 0) return false;
 			}
+
+			if (ZSTD_isError(ZSTD_decompressStream(Stream, &OutBuffer, &InBuffer))) return false;
 		}
 
-		for (const auto& Vert : Vertices)
+		return true;
+	}
+
+	bool Read(void* Data, uint64_t Size)
+	{
+		if (Stream == nullptr)
 		{
-			float Normal[3] = { Vert.NX, Vert.NY, Vert.NZ };
-			fwrite(Normal,3 * sizeof(float), 1, File);
+			return fread(Data, 1, Size, File) == Size;
+		}
 
-			Delta += ProgressPerNormal;
-			
-			if (Delta >= 0.01)
-			{
-				Progress += Delta;
-				Delta = 0.0;
-				PrintProgress(Progress);
-			}
+		for (; Skip > 0; Skip -= std::min<uint64_t>(Skip, Scratch.size()))
+		{
+			if (!Decode(Scratch.data(), std::min<uint64_t>(Skip, Scratch.size()))) return false;
 		}
 
-		PrintProgress(1.0);
-		printf("\n");
+		return Decode(Data, Size);
 	}
-	else
-	{
-		printf("Compressing...\n");
 
-		uint64_t DataCount = (Vertices.size() * 3)
-		                   + (Vertices.size() * 2)
-		                   + (Vertices.size() * 3);
-
-		uint64_t DataSize = DataCount * sizeof(float);
-		uint64_t Bound = ZSTD_compressBound(DataSize);
-		uint64_t Counter = 0;
+	void Close()
+	{
+		if (File != nullptr) fclose(File);
+		ZSTD_freeDStream(Stream);
 
-		float* Data = new float[DataCount];
-		uint8_t* Compressed = new uint8_t[Bound];
+		File = nullptr;
+		Stream = nullptr;
+	}
+};
 
-		double CompressProgressPerVertex = 0.5 / Vertices.size() * (3.0 / 8.0);
-		double CompressProgressPerUV     = 0.5 / Vertices.size() * (2.0 / 8.0);
-		double CompressProgressPerNormal = 0.5 / Vertices.size() * (3.0 / 8.0);
-		double CompressProgress = 0.0;
-		double CompressDelta = 0.0;
+class CMFStreamReader
+{
+public:
+	bool Open(const char* FileName)
+	{
+		Close();
 
-		for (const auto& Vert : Vertices)
-		{
-			Data[Counter++] = Vert.X;
-			Data[Counter++] = Vert.Y;
-			Data[Counter++] = Vert.Z;
+		FILE* File = fopen(FileName, "rb");
+		if (File == nullptr) return false;
 
-			CompressDelta += CompressProgressPerVertex;
+		uint8_t Magic[21];
+		uint32_t Count = 0;
+		uint8_t Compression = 0;
 
-			if (CompressDelta >= 0.01)
-			{
-				CompressProgress += CompressDelta;
-				CompressDelta = 0.0;
-				PrintProgress(CompressProgress);
-			}
-		}
+		bool Valid = fread(Magic, 1, 21, File) == 21
+		          && fread(&Count, 1, sizeof(uint32_t), File) == sizeof(uint32_t)
+		          && fread(&Compression, 1, sizeof(uint8_t), File) == sizeof(uint8_t)
+		          && memcmp(Magic, "COLUMBUS MODEL FORMAT", 21) == 0;
+		fclose(File);
 
-		for (const auto& Vert : Vertices)
-		{
-			Data[Counter++] = Vert.U;
-			Data[Counter++] = Vert.V;
+		if (!Valid) return false;
 
-			CompressDelta += CompressProgressPerUV;
+		bool Compressed = Compression == 0xFF;
+		VertexCount = (uint64_t)Count * 3;
+		Position = 0;
 
-			if (CompressDelta >= 0.01)
-			{
-				CompressProgress += CompressDelta;
-				CompressDelta = 0.0;
-				PrintProgress(CompressProgress);
-			}
-		}
+		uint64_t TexcoordsOffset = VertexCount * 3 * sizeof(float);
+		uint64_t NormalsOffset = VertexCount * 5 * sizeof(float);
 
-		for (const auto& Vert : Vertices)
+		if (Compressed)
 		{
-			Data[Counter++] = Vert.NX;
-			Data[Counter++] = Vert.NY;
-			Data[Counter++] = Vert.NZ;
-
-			CompressDelta += CompressProgressPerNormal;
-
-			if (CompressDelta >= 0.01)
-			{
-				CompressProgress += CompressDelta;
-				CompressDelta = 0.0;
-				PrintProgress(CompressProgress);
-			}
+			return Positions.Open(FileName, 26, true, 0)
+			    && Texcoords.Open(FileName, 26, true, TexcoordsOffset)
+			    && Normals.Open(FileName, 26, true, NormalsOffset);
 		}
 
-		uint64_t CompressedDataSize = ZSTD_compress(Compressed, Bound, Data, DataSize, 1);
-		delete[] Data;
+		return Positions.Open(FileName, 26, false, 0)
+		    && Texcoords.Open(FileName, 26 + TexcoordsOffset, false, 0)
+		    && Normals.Open(FileName, 26 + NormalsOffset, false, 0);
+	}
+
+	// Reads up to MaxCount next vertices, OutCount is 0 at the end of file
+	bool Read(Vertex* Vertices, uint64_t MaxCount, uint64_t* OutCount)
+	{
+		uint64_t Count = std::min(MaxCount, VertexCount - Position);
+		*OutCount = 0;
 
-		PrintProgress(1.0);
-		printf("\n");
+		if (Count == 0) return true;
 
-		printf("Saving CMF file...\n");
+		Buffer.resize(Count * 8);
+		float* VBuffer = Buffer.data();
+		float* UBuffer = VBuffer + Count * 3;
+		float* NBuffer = UBuffer + Count * 2;
 
-		double SaveProgressPerByte = 1.0 / CompressedDataSize;
-		double SaveProgress = 0.0;
-		double SaveDelta = 0.0;
+		if (!Positions.Read(VBuffer, Count * 3 * sizeof(float))) return false;
+		if (!Texcoords.Read(UBuffer, Count * 2 * sizeof(float))) return false;
+		if (!Normals.Read(NBuffer, Count * 3 * sizeof(float))) return false;
 
-		for (uint64_t i = 0; i < CompressedDataSize; i++)
+		struct CMF_InfoArray Arrays[3] =
 		{
-			fwrite(&Compressed[i], sizeof(uint8_t), 1, File);
+			{ CMF_TYPE_POSITION, CMF_FORMAT_FLOAT, (uint32_t)(Count * 3 * sizeof(float)), VBuffer },
+			{ CMF_TYPE_TEXCOORD, CMF_FORMAT_FLOAT, (uint32_t)(Count * 2 * sizeof(float)), UBuffer },
+			{ CMF_TYPE_NORMAL,   CMF_FORMAT_FLOAT, (uint32_t)(Count * 3 * sizeof(float)), NBuffer }
+		};
 
-			SaveDelta += SaveProgressPerByte;
+		if (CMF_Interleave(Arrays, 3, Count, Vertices, sizeof(Vertex)) != 0) return false;
 
-			if (SaveDelta >= 0.01)
-			{
-				SaveProgress += SaveDelta;
-				SaveDelta = 0.0;
-				PrintProgress(SaveProgress);
-			}
-		}
+		Position += Count;
+		*OutCount = Count;
+		return true;
+	}
 
-		delete[] Compressed;
+	uint64_t GetVertexCount() const
+	{
+		return VertexCount;
+	}
 
-		PrintProgress(1.0);
-		printf("\n");
+	void Close()
+	{
+		Positions.Close();
+		Texcoords.Close();
+		Normals.Close();
 	}
 
-	fclose(File);
+	~CMFStreamReader()
+	{
+		Close();
+	}
+private:
+	CMFStreamCursor Positions;
+	CMFStreamCursor Texcoords;
+	CMFStreamCursor Normals;
+	std::vector<float> Buffer;
+	uint64_t VertexCount = 0;
+	uint64_t Position = 0;
+};
+
+bool LoadCMFStream(const char* FileName, uint64_t ChunkSize, const std::function<bool(const Vertex*, uint64_t)>& Callback)
+{
+	CMFStreamReader Reader;
+	if (!Reader.Open(FileName)) return false;
+
+	std::vector<Vertex> Chunk(ChunkSize);
+	uint64_t Count = 0;
+
+	do
+	{
+		if (!Reader.Read(Chunk.data(), ChunkSize, &Count)) return false;
+		if (Count > 0 && !Callback(Chunk.data(), Count)) return false;
+	} while (Count > 0);
 
 	return true;
 }
 
+/*
+* Vertices are split into arrays by chunks with CMF_Deinterleave right into one buffer of all arrays,
+* which is compressed by one call and written by large blocks.
+*/
+bool SaveCMF(const char* FileName, const std::vector<Vertex>& Vertices, bool Compressed, ZSTD_CCtx* Context, bool Progress)
+{
+	uint64_t VertexCount = Vertices.size();
+	uint64_t DataSize = VertexCount * CMF_V0_VERTEX_SIZE;
 
+	// Arrays are packed and compressed, then written, so every byte is counted twice
+	ProgressReporter Reporter(DataSize * 2, !Progress);
+	std::vector<uint8_t> Data(DataSize);
 
+	uint8_t* Positions = Data.data();
+	uint8_t* Texcoords = Positions + VertexCount * 3 * sizeof(float);
+	uint8_t* Normals = Texcoords + VertexCount * 2 * sizeof(float);
 
+	for (uint64_t Offset = 0; Offset < VertexCount; Offset += INTERLEAVE_CHUNK)
+	{
+		uint64_t Chunk = std::min<uint64_t>(INTERLEAVE_CHUNK, VertexCount - Offset);
 
+		struct CMF_InfoArray Arrays[3] =
+		{
+			{ CMF_TYPE_POSITION, CMF_FORMAT_FLOAT, (uint32_t)(Chunk * 3 * sizeof(float)), Positions + Offset * 3 * sizeof(float) },
+			{ CMF_TYPE_TEXCOORD, CMF_FORMAT_FLOAT, (uint32_t)(Chunk * 2 * sizeof(float)), Texcoords + Offset * 2 * sizeof(float) },
+			{ CMF_TYPE_NORMAL,   CMF_FORMAT_FLOAT, (uint32_t)(Chunk * 3 * sizeof(float)), Normals + Offset * 3 * sizeof(float) }
+		};
 
+		if (CMF_Deinterleave(Vertices.data() + Offset, sizeof(Vertex), (uint32_t)Chunk, Arrays, 3) != 0) return false;
+		Reporter.Add(Chunk * CMF_V0_VERTEX_SIZE);
+	}
 
+	if (Compressed)
+	{
+		std::vector<uint8_t> Packed(ZSTD_compressBound(DataSize));
 
+		size_t PackedSize = Context != nullptr
+			? ZSTD_compressCCtx(Context, Packed.data(), Packed.size(), Data.data(), DataSize, 1)
+			: ZSTD_compress(Packed.data(), Packed.size(), Data.data(), DataSize, 1);
 
+		if (ZSTD_isError(PackedSize)) return false;
 
+		Packed.resize(PackedSize);
+		Data.swap(Packed);
+	}
 
+	uint8_t Header[CMF_V0_HEADER_SIZE];
+	uint32_t Count = (uint32_t)(VertexCount / 3);
+	memcpy(Header, "COLUMBUS MODEL FORMAT", 21);
+	memcpy(Header + 21, &Count, sizeof(uint32_t));
+	Header[25] = Compressed ? 0xFF : 0x00;
 
+	BulkWriter Writer;
+	if (!Writer.Open(FileName)) return false;
 
+	bool Result = Writer.Write(Header, sizeof(Header));
 
+	for (uint64_t Offset = 0; Offset < Data.size() && Result; Offset += BULK_BLOCK_SIZE)
+	{
+		uint64_t Size = std::min<uint64_t>(BULK_BLOCK_SIZE, Data.size() - Offset);
+		Result = Writer.Write(Data.data() + Offset, Size);
+		Reporter.Add(Size * DataSize / Data.size());
+	}
 
-
+	return Writer.Close() && Result;
+}
@@ -0,0 +1,472 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "util.h"
+#include "cmf_index.h"
+#include "../library/cmf.h"
+
+#define GLB_MAGIC      0x46546C67
+#define GLB_CHUNK_JSON 0x4E4F534A
+#define GLB_CHUNK_BIN  0x004E4942
+#define JSON_MAX_DEPTH 64
+
+// Component types of glTF accessors, they are OpenGL enums
+#define GLTF_BYTE           5120
+#define GLTF_UNSIGNED_BYTE  5121
+#define GLTF_SHORT          5122
+#define GLTF_UNSIGNED_SHORT 5123
+#define GLTF_UNSIGNED_INT   5125
+#define GLTF_FLOAT          5126
+
+// Value of JSON document, keys of object are parallel to its items
+struct JsonValue
+{
+	enum Kind { JsonNull, JsonBool, JsonNumber, JsonString, JsonArray, JsonObject };
+
+	Kind Type = JsonNull;
+	double Number = 0.0;
+	std::string String;
+	std::vector<std::string> Keys;
+	std::vector<JsonValue> Items;
+
+	const JsonValue* Find(const char* Key) const
+	{
+		for (size_t i = 0; i < Keys.size(); i++) if (Keys[i] == Key) return &Items[i];
+		return nullptr;
+	}
+
+	// Indices are numbers of document, so they are checked before conversion
+	const JsonValue* At(double Index) const
+	{
+		return Type == JsonArray && Index >= 0.0 && Index < (double)Items.size() ? &Items[(size_t)Index] : nullptr;
+	}
+
+	// Number of member, Default if it is missing or is not a number
+	double Get(const char* Key, double Default) const
+	{
+		const JsonValue* Value = Find(Key);
+		return Value != nullptr && Value->Type == JsonNumber ? Value->Number : Default;
+	}
+};
+
+static const char* JsonSkipSpaces(const char* P, const char* End)
+{
+	while (P < End && (*P == ' ' || *P == '\t' || *P == '\n' || *P == '\r')) P++;
+	return P;
+}
+
+static const char* JsonParseString(const char* P, const char* End, std::string& String)
+{
+	if (P == End || *P != '"') return nullptr;
+
+	for (P++; P < End && *P != '"'; P++)
+	{
+		if (*P != '\\') { String += *P; continue; }
+		if (++P == End) return nullptr;
+
+		switch (*P)
+		{
+		case 'b': String += '\b'; break;
+		case 'f': String += '\f'; break;
+		case 'n': String += '\n'; break;
+		case 'r': String += '\r'; break;
+		case 't': String += '\t'; break;
+		case 'u':
+		{
+			if (End - P < 5) return nullptr;
+
+			char Hex[5] = { P[1], P[2], P[3], P[4], 0 };
+			char* HexEnd;
+			uint32_t Code = (uint32_t)strtoul(Hex, &HexEnd, 16);
+			if (HexEnd != Hex + 4) return nullptr;
+
+			// Code units are encoded separately, names of glTF are compared only for equality
+			if (Code < 0x80) String += (char)Code;
+			else if (Code < 0x800) { String += (char)(0xC0 | Code >> 6); String += (char)(0x80 | (Code & 0x3F)); }
+			else { String += (char)(0xE0 | Code >> 12); String += (char)(0x80 | (Code >> 6 & 0x3F)); String += (char)(0x80 | (Code & 0x3F)); }
+
+			P += 4;
+			break;
+		}
+		default: String += *P; break;
+		}
+	}
+
+	return P < End ? P + 1 : nullptr;
+}
+
+/*
+* Recursive descent parser of JSON, depth of nesting is limited,
+* so malformed files can not overflow the stack.
+*/
+static const char* JsonParse(const char* P, const char* End, JsonValue& Value, int Depth = 0)
+{
+	P = JsonSkipSpaces(P, End);
+	if (P == End || Depth > JSON_MAX_DEPTH) return nullptr;
+
+	if (*P == '{' || *P == '[')
+	{
+		bool IsObject = *P == '{';
+		char Close = IsObject ? '}' : ']';
+
+		Value.Type = IsObject ? JsonValue::JsonObject : JsonValue::JsonArray;
+		P = JsonSkipSpaces(P + 1, End);
+
+		if (P < End && *P == Close) return P + 1;
+
+		while (P != nullptr && P < End)
+		{
+			if (IsObject)
+			{
+				Value.Keys.emplace_back();
+				P = JsonParseString(JsonSkipSpaces(P, End), End, Value.Keys.back());
+				if (P == nullptr) return nullptr;
+
+				P = JsonSkipSpaces(P, End);
+				if (P == End || *P++ != ':') return nullptr;
+			}
+
+			Value.Items.emplace_back();
+			P = JsonParse(P, End, Value.Items.back(), Depth + 1);
+			if (P == nullptr) return nullptr;
+
+			P = JsonSkipSpaces(P, End);
+			if (P == End) return nullptr;
+			if (*P == Close) return P + 1;
+			if (*P++ != ',') return nullptr;
+		}
+
+		return nullptr;
+	}
+
+	if (*P == '"')
+	{
+		Value.Type = JsonValue::JsonString;
+		return JsonParseString(P, End, Value.String);
+	}
+
+	const char* Words[3] = { "true", "false", "null" };
+
+	for (int i = 0; i < 3; i++)
+	{
+		size_t Length = strlen(Words[i]);
+
+		if ((size_t)(End - P) >= Length && memcmp(P, Words[i], Length) == 0)
+		{
+			Value.Type = i < 2 ? JsonValue::JsonBool : JsonValue::JsonNull;
+			Value.Number = i == 0 ? 1.0 : 0.0;
+			return P + Length;
+		}
+	}
+
+	// Chunk has no terminating zero, so number is copied for strtod
+	char Token[64];
+	size_t Length = 0;
+
+	while (P + Length < End && Length + 1 < sizeof(Token) && P[Length] != 0 && strchr("+-.0123456789eE", P[Length]) != nullptr)
+	{
+		Token[Length] = P[Length];
+		Length++;
+	}
+
+	Token[Length] = 0;
+
+	char* Parsed;
+	Value.Type = JsonValue::JsonNumber;
+	Value.Number = strtod(Token, &Parsed);
+
+	return Parsed == Token ? nullptr : P + (Parsed - Token);
+}
+
+// Elements of accessor inside of binary chunk, Count is 0 if primitive has no such attribute
+struct GltfAccessor
+{
+	const uint8_t* Data = nullptr;
+	uint64_t Count = 0;
+	uint32_t ComponentType = 0;
+	uint32_t Components = 0;
+	uint32_t ElementSize = 0;
+	uint32_t Stride = 0;
+	bool Normalized = false;
+};
+
+struct GltfPrimitive
+{
+	GltfAccessor Positions;
+	GltfAccessor Texcoords;
+	GltfAccessor Normals;
+	GltfAccessor Indices;
+};
+
+// Triangle primitives of all meshes of file, accessors point into its mapping
+struct GltfModel
+{
+	struct CMF_Mapping Mapping = { nullptr, 0 };
+	std::vector<GltfPrimitive> Primitives;
+};
+
+static uint32_t GltfComponentSize(uint32_t ComponentType)
+{
+	switch (ComponentType)
+	{
+	case GLTF_BYTE:
+	case GLTF_UNSIGNED_BYTE:  return 1;
+	case GLTF_SHORT:
+	case GLTF_UNSIGNED_SHORT: return 2;
+	case GLTF_UNSIGNED_INT:
+	case GLTF_FLOAT:          return 4;
+	}
+
+	return 0;
+}
+
+// Resolves accessor into binary chunk, sparse accessors and external buffers are not supported
+static bool GltfReadAccessor(const JsonValue& Document, const uint8_t* Binary, uint64_t BinarySize, double Index, GltfAccessor& Accessor)
+{
+	const JsonValue* Accessors = Document.Find("accessors");
+	const JsonValue* Views = Document.Find("bufferViews");
+	const JsonValue* Buffers = Document.Find("buffers");
+	if (Accessors == nullptr || Views == nullptr || Buffers == nullptr) return false;
+
+	const JsonValue* Json = Accessors->At(Index);
+	if (Json == nullptr || Json->Find("sparse") != nullptr) return false;
+
+	const JsonValue* View = Views->At(Json->Get("bufferView", -1));
+	if (View == nullptr) return false;
+
+	const JsonValue* Buffer = Buffers->At(View->Get("buffer", -1));
+	if (Buffer == nullptr || Buffer != Buffers->At(0) || Buffer->Find("uri") != nullptr || Binary == nullptr) return false;
+
+	const JsonValue* Type = Json->Find("type");
+	if (Type == nullptr) return false;
+
+	const char* Types[4] = { "SCALAR", "VEC2", "VEC3", "VEC4" };
+	for (uint32_t i = 0; i < 4; i++) if (Type->String == Types[i]) Accessor.Components = i + 1;
+
+	const JsonValue* Normalized = Json->Find("normalized");
+
+	double ComponentType = Json->Get("componentType", 0);
+	double Count = Json->Get("count", 0);
+	double Stride = View->Get("byteStride", 0);
+	double ViewOffset = View->Get("byteOffset", 0);
+	double ViewLength = View->Get("byteLength", 0);
+	double Offset = Json->Get("byteOffset", 0);
+
+	if (ComponentType < 0 || ComponentType > 0xFFFF || Count < 1 || Count > 0xFFFFFFFF || Stride < 0 || Stride > 255) return false;
+	if (ViewOffset < 0 || Offset < 0 || ViewOffset + ViewLength > (double)BinarySize) return false;
+
+	Accessor.ComponentType = (uint32_t)ComponentType;
+	Accessor.Count = (uint64_t)Count;
+	Accessor.Normalized = Normalized != nullptr && Normalized->Number != 0.0;
+	Accessor.ElementSize = GltfComponentSize(Accessor.ComponentType) * Accessor.Components;
+	Accessor.Stride = Stride != 0 ? (uint32_t)Stride : Accessor.ElementSize;
+
+	if (Accessor.ElementSize == 0 || Accessor.Stride < Accessor.ElementSize) return false;
+	if (Offset + (double)Accessor.Stride * (Accessor.Count - 1) + Accessor.ElementSize > ViewLength) return false;
+
+	Accessor.Data = Binary + (uint64_t)ViewOffset + (uint64_t)Offset;
+	return true;
+}
+
+static bool GltfIsFloat(const GltfAccessor& Accessor, uint32_t Components)
+{
+	return Accessor.Count == 0 || (Accessor.ComponentType == GLTF_FLOAT && Accessor.Components == Components);
+}
+
+static uint32_t GltfIndex(const GltfAccessor& Indices, uint64_t i)
+{
+	const uint8_t* Element = Indices.Data + i * Indices.Stride;
+
+	switch (Indices.ComponentType)
+	{
+	case GLTF_UNSIGNED_BYTE:  return *Element;
+	case GLTF_UNSIGNED_SHORT: { uint16_t Index; memcpy(&Index, Element, 2); return Index; }
+	}
+
+	uint32_t Index;
+	memcpy(&Index, Element, 4);
+	return Index;
+}
+
+// Checks types of attributes and that every index points to vertex of primitive
+static bool GltfValidatePrimitive(const GltfPrimitive& Primitive)
+{
+	const GltfAccessor& Texcoords = Primitive.Texcoords;
+	const GltfAccessor& Indices = Primitive.Indices;
+	uint64_t Count = Primitive.Positions.Count;
+
+	bool Valid = GltfIsFloat(Primitive.Positions, 3) && GltfIsFloat(Primitive.Normals, 3) &&
+		(Texcoords.Count == 0 || (Texcoords.Components == 2 && (Texcoords.ComponentType == GLTF_FLOAT ||
+		(Texcoords.Normalized && (Texcoords.ComponentType == GLTF_UNSIGNED_BYTE || Texcoords.ComponentType == GLTF_UNSIGNED_SHORT)))));
+
+	if (Texcoords.Count != 0 && Texcoords.Count != Count) Valid = false;
+	if (Primitive.Normals.Count != 0 && Primitive.Normals.Count != Count) Valid = false;
+	if (!Valid) return false;
+
+	if (Indices.Count == 0) return Count % 3 == 0;
+
+	if (Indices.Components != 1 || Indices.Count % 3 != 0 || Indices.Stride != Indices.ElementSize) return false;
+	if (Indices.ComponentType != GLTF_UNSIGNED_BYTE && Indices.ComponentType != GLTF_UNSIGNED_SHORT && Indices.ComponentType != GLTF_UNSIGNED_INT) return false;
+
+	for (uint64_t i = 0; i < Indices.Count; i++) if (GltfIndex(Indices, i) >= Count) return false;
+
+	return true;
+}
+
+/*
+* Opens binary glTF 2.0, maps it and collects triangle primitives of all meshes. Primitives are
+* read in space of their meshes, transforms of nodes are not applied. Positions and normals
+* must be floats, texture coordinates may be normalized bytes or shorts.
+*/
+bool OpenGLB(const char* FileName, GltfModel& Model)
+{
+	if (CMF_MapFile(FileName, &Model.Mapping) != 0) return false;
+
+	const uint8_t* Data = (const uint8_t*)Model.Mapping.address;
+	uint64_t Size = Model.Mapping.length;
+	uint32_t Header[3];
+
+	const char* Json = nullptr;
+	uint64_t JsonSize = 0;
+	const uint8_t* Binary = nullptr;
+	uint64_t BinarySize = 0;
+
+	if (Size >= sizeof(Header)) memcpy(Header, Data, sizeof(Header));
+	bool Result = Size >= sizeof(Header) && Header[0] == GLB_MAGIC && Header[1] == 2 && Header[2] <= Size;
+
+	// Chunks are aligned by 4 bytes, the first is JSON and the second is optional binary
+	for (uint64_t Offset = 12; Result && Offset + 8 <= Header[2];)
+	{
+		uint32_t Chunk[2];
+		memcpy(Chunk, Data + Offset, sizeof(Chunk));
+
+		if (Offset + 8 + Chunk[0] > Header[2]) { Result = false; break; }
+
+		if (Chunk[1] == GLB_CHUNK_JSON && Json == nullptr) { Json = (const char*)Data + Offset + 8; JsonSize = Chunk[0]; }
+		if (Chunk[1] == GLB_CHUNK_BIN && Binary == nullptr) { Binary = Data + Offset + 8; BinarySize = Chunk[0]; }
+
+		Offset += 8 + ((Chunk[0] + 3ull) & ~3ull);
+	}
+
+	JsonValue Document;
+	Result = Result && Json != nullptr && JsonParse(Json, Json + JsonSize, Document) != nullptr && Document.Type == JsonValue::JsonObject;
+
+	const JsonValue* Meshes = Result ? Document.Find("meshes") : nullptr;
+
+	for (uint64_t m = 0; Meshes != nullptr && m < Meshes->Items.size() && Result; m++)
+	{
+		const JsonValue* Primitives = Meshes->Items[m].Find("primitives");
+
+		for (uint64_t p = 0; Primitives != nullptr && p < Primitives->Items.size() && Result; p++)
+		{
+			const JsonValue& Item = Primitives->Items[p];
+			const JsonValue* Attributes = Item.Find("attributes");
+
+			// Points, lines and strips are skipped
+			if (Item.Get("mode", 4) != 4 || Attributes == nullptr || Attributes->Find("POSITION") == nullptr) continue;
+
+			GltfPrimitive Primitive;
+
+			const char* Names[3] = { "POSITION", "TEXCOORD_0", "NORMAL" };
+			GltfAccessor* Accessors[3] = { &Primitive.Positions, &Primitive.Texcoords, &Primitive.Normals };
+
+			for (int a = 0; a < 3 && Result; a++)
+			{
+				if (Attributes->Find(Names[a]) == nullptr) continue;
+				Result = GltfReadAccessor(Document, Binary, BinarySize, Attributes->Get(Names[a], -1), *Accessors[a]);
+			}
+
+			if (Result && Item.Find("indices") != nullptr)
+			{
+				Result = GltfReadAccessor(Document, Binary, BinarySize, Item.Get("indices", -1), Primitive.Indices);
+			}
+
+			Result = Result && GltfValidatePrimitive(Primitive);
+			Model.Primitives.push_back(Primitive);
+		}
+	}
+
+	if (!Result || Model.Primitives.empty())
+	{
+		CMF_UnmapFile(&Model.Mapping);
+		Model.Primitives.clear();
+		return false;
+	}
+
+	return true;
+}
+
+void CloseGLB(GltfModel& Model)
+{
+	CMF_UnmapFile(&Model.Mapping);
+	Model.Primitives.clear();
+}
+
+/*
+* Single primitive of float attributes is written into arrays right from mapping,
+* models of several primitives or normalized texture coordinates are converted into vertices.
+*/
+bool GltfIsDirect(const GltfModel& Model)
+{
+	return Model.Primitives.size() == 1 && GltfIsFloat(Model.Primitives[0].Texcoords, 2);
+}
+
+// Converts all primitives into one indexed mesh, missing attributes are zeros
+bool GltfToVertices(const GltfModel& Model, std::vector<Vertex>& Vertices, std::vector<uint32_t>& Indices)
+{
+	Vertices.clear();
+	Indices.clear();
+
+	for (const auto& Primitive : Model.Primitives)
+	{
+		uint64_t Base = Vertices.size();
+		uint64_t Count = Primitive.Positions.Count;
+		const GltfAccessor& Texcoords = Primitive.Texcoords;
+		const GltfAccessor& Normals = Primitive.Normals;
+
+		if (Base + Count > INDEX_EMPTY) return false;
+
+		Vertices.resize(Base + Count, Vertex{});
+
+		for (uint64_t i = 0; i < Count; i++)
+		{
+			Vertex& Vert = Vertices[Base + i];
+			memcpy(&Vert.X, Primitive.Positions.Data + i * Primitive.Positions.Stride, 3 * sizeof(float));
+
+			if (Normals.Count != 0) memcpy(&Vert.NX, Normals.Data + i * Normals.Stride, 3 * sizeof(float));
+			if (Texcoords.Count == 0) continue;
+
+			const uint8_t* Element = Texcoords.Data + i * Texcoords.Stride;
+
+			switch (Texcoords.ComponentType)
+			{
+			case GLTF_FLOAT: memcpy(&Vert.U, Element, 2 * sizeof(float)); break;
+			case GLTF_UNSIGNED_BYTE: Vert.U = Element[0] / 255.0f; Vert.V = Element[1] / 255.0f; break;
+			case GLTF_UNSIGNED_SHORT:
+			{
+				uint16_t UV[2];
+				memcpy(UV, Element, sizeof(UV));
+				Vert.U = UV[0] / 65535.0f;
+				Vert.V = UV[1] / 65535.0f;
+				break;
+			}
+			}
+		}
+
+		const GltfAccessor& Inds = Primitive.Indices;
+		uint64_t IndexCount = Inds.Count != 0 ? Inds.Count : Count;
+
+		Indices.reserve(Indices.size() + IndexCount);
+
+		for (uint64_t i = 0; i < IndexCount; i++)
+		{
+			Indices.push_back((uint32_t)(Base + (Inds.Count != 0 ? GltfIndex(Inds, i) : i)));
+		}
+	}
+
+	return true;
+}
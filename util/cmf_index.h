@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "util.h"
+#include "../library/cmf.h"
+
+#define INDEX_EMPTY 0xFFFFFFFF
+
+uint32_t HashVertex(const Vertex& Vert)
+{
+	uint32_t Words[sizeof(Vertex) / sizeof(uint32_t)];
+	memcpy(Words, &Vert, sizeof(Vertex));
+
+	// Murmur3 mixing of every word
+	uint32_t Hash = 0;
+
+	for (uint32_t Word : Words)
+	{
+		Word *= 0xCC9E2D51;
+		Word = (Word << 15) | (Word >> 17);
+		Word *= 0x1B873593;
+
+		Hash ^= Word;
+		Hash = (Hash << 13) | (Hash >> 19);
+		Hash = Hash * 5 + 0xE6546B64;
+	}
+
+	Hash ^= Hash >> 16;
+	Hash *= 0x85EBCA6B;
+	Hash ^= Hash >> 13;
+	Hash *= 0xC2B2AE35;
+	Hash ^= Hash >> 16;
+
+	return Hash;
+}
+
+/*
+* Welds bitwise identical vertices with open addressing hash table.
+* Verts are replaced with unique vertices in order of their first use,
+* Indices receive index of unique vertex for every source vertex.
+*/
+void WeldVertices(std::vector<Vertex>& Verts, std::vector<uint32_t>& Indices)
+{
+	uint64_t Size = 1;
+	while (Size < Verts.size() * 2) Size *= 2;
+
+	std::vector<uint32_t> Table(Size, INDEX_EMPTY);
+	uint64_t Mask = Size - 1;
+	uint32_t Unique = 0;
+
+	Indices.resize(Verts.size());
+
+	for (uint64_t i = 0; i < Verts.size(); i++)
+	{
+		uint64_t Slot = HashVertex(Verts[i]) & Mask;
+
+		// Linear probing, table is at most half full
+		while (Table[Slot] != INDEX_EMPTY && memcmp(&Verts[Table[Slot]], &Verts[i], sizeof(Vertex)) != 0)
+		{
+			Slot = (Slot + 1) & Mask;
+		}
+
+		if (Table[Slot] == INDEX_EMPTY)
+		{
+			// Unique vertices are compacted in place, Unique never exceeds i
+			Verts[Unique] = Verts[i];
+			Table[Slot] = Unique++;
+		}
+
+		Indices[i] = Table[Slot];
+	}
+
+	Verts.resize(Unique);
+	Verts.shrink_to_fit();
+}
+
+// Smallest format which holds every index of given count of vertices
+uint32_t IndexFormat(uint64_t VertexCount)
+{
+	if (VertexCount <= 0x100)   return CMF_FORMAT_UBYTE;
+	if (VertexCount <= 0x10000) return CMF_FORMAT_USHORT;
+	return CMF_FORMAT_UINT;
+}
+
+uint32_t IndexSize(uint32_t Format)
+{
+	switch (Format)
+	{
+	case CMF_FORMAT_UBYTE:  return 1;
+	case CMF_FORMAT_USHORT: return 2;
+	}
+
+	return 4;
+}
+
+// Narrows indices into format given by IndexFormat
+void PackIndices(const uint32_t* Indices, uint64_t Count, uint32_t Format, void* Out)
+{
+	switch (Format)
+	{
+	case CMF_FORMAT_UBYTE:
+		for (uint64_t i = 0; i < Count; i++) ((uint8_t*)Out)[i] = (uint8_t)Indices[i];
+		break;
+	case CMF_FORMAT_USHORT:
+		for (uint64_t i = 0; i < Count; i++) ((uint16_t*)Out)[i] = (uint16_t)Indices[i];
+		break;
+	default:
+		memcpy(Out, Indices, Count * sizeof(uint32_t));
+		break;
+	}
+}
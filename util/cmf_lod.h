@@ -0,0 +1,288 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "util.h"
+#include "cmf_index.h"
+
+#define SIMPLIFY_MAX_PASSES 100
+
+// Symmetric 4x4 matrix of plane quadric with total weight of planes
+struct Quadric
+{
+	double A2, AB, AC, AD, B2, BC, BD, C2, CD, D2;
+	double Weight;
+};
+
+void QuadricAdd(Quadric& Q, const Quadric& R)
+{
+	Q.A2 += R.A2; Q.AB += R.AB; Q.AC += R.AC; Q.AD += R.AD;
+	Q.B2 += R.B2; Q.BC += R.BC; Q.BD += R.BD;
+	Q.C2 += R.C2; Q.CD += R.CD;
+	Q.D2 += R.D2;
+	Q.Weight += R.Weight;
+}
+
+// Weighted sum of squared distances from point to planes of quadric
+double QuadricError(const Quadric& Q, const Vertex& V)
+{
+	double X = V.X, Y = V.Y, Z = V.Z;
+
+	double Error = Q.A2 * X * X + Q.B2 * Y * Y + Q.C2 * Z * Z + Q.D2
+	             + 2.0 * (Q.AB * X * Y + Q.AC * X * Z + Q.BC * Y * Z + Q.AD * X + Q.BD * Y + Q.CD * Z);
+
+	return std::max(Error, 0.0);
+}
+
+static void TriangleNormal(const Vertex& A, const Vertex& B, const Vertex& C, double* N)
+{
+	double E1[3] = { (double)B.X - A.X, (double)B.Y - A.Y, (double)B.Z - A.Z };
+	double E2[3] = { (double)C.X - A.X, (double)C.Y - A.Y, (double)C.Z - A.Z };
+
+	N[0] = E1[1] * E2[2] - E1[2] * E2[1];
+	N[1] = E1[2] * E2[0] - E1[0] * E2[2];
+	N[2] = E1[0] * E2[1] - E1[1] * E2[0];
+}
+
+/*
+* Vertices on attribute seams (sharing position with other vertex) and on open borders
+* can't be moved without tearing the mesh, so they are never collapsed.
+*/
+static std::vector<uint8_t> FindLockedVertices(const std::vector<uint32_t>& Inds, const std::vector<Vertex>& Verts)
+{
+	std::vector<uint8_t> Locked(Verts.size(), 0);
+
+	uint64_t Size = 1;
+	while (Size < Verts.size() * 2) Size *= 2;
+
+	std::vector<uint32_t> Table(Size, INDEX_EMPTY);
+
+	for (uint32_t v = 0; v < Verts.size(); v++)
+	{
+		float Position[3] = { Verts[v].X, Verts[v].Y, Verts[v].Z };
+		Vertex Key = {};
+		memcpy(&Key, Position, sizeof(Position));
+
+		uint64_t Slot = HashVertex(Key) & (Size - 1);
+
+		while (Table[Slot] != INDEX_EMPTY && memcmp(&Verts[Table[Slot]], Position, sizeof(Position)) != 0)
+		{
+			Slot = (Slot + 1) & (Size - 1);
+		}
+
+		if (Table[Slot] == INDEX_EMPTY) Table[Slot] = v;
+		else Locked[v] = Locked[Table[Slot]] = 1;
+	}
+
+	// Edge is on border if there is no edge in opposite direction
+	std::vector<uint64_t> Edges;
+	Edges.reserve(Inds.size());
+
+	for (uint64_t i = 0; i < Inds.size(); i += 3)
+	{
+		for (int k = 0; k < 3; k++) Edges.push_back(((uint64_t)Inds[i + k] << 32) | Inds[i + (k + 1) % 3]);
+	}
+
+	std::sort(Edges.begin(), Edges.end());
+
+	for (uint64_t Edge : Edges)
+	{
+		uint64_t Opposite = (Edge << 32) | (Edge >> 32);
+
+		if (!std::binary_search(Edges.begin(), Edges.end(), Opposite))
+		{
+			Locked[Edge >> 32] = Locked[Edge & 0xFFFFFFFF] = 1;
+		}
+	}
+
+	return Locked;
+}
+
+struct Collapse
+{
+	uint32_t From;
+	uint32_t To;
+	double Cost;
+};
+
+/*
+* Simplifies indexed triangles by quadric error metric edge collapses, vertex is collapsed into
+* its neighbour, so vertex arrays are shared by all levels. Every pass sorts the best collapse of every vertex
+* and applies them while they don't touch each other. Returns error of the result, it is distance
+* in units of positions, which should be projected onto screen to select level.
+*/
+float SimplifyMesh(const std::vector<Vertex>& Verts, const std::vector<uint32_t>& Inds, uint64_t TargetCount, std::vector<uint32_t>& Result)
+{
+	uint32_t VertexCount = (uint32_t)Verts.size();
+	std::vector<uint8_t> Locked = FindLockedVertices(Inds, Verts);
+	std::vector<Quadric> Quadrics(VertexCount, Quadric{});
+
+	Result = Inds;
+
+	for (uint64_t i = 0; i < Result.size(); i += 3)
+	{
+		double N[3];
+		TriangleNormal(Verts[Result[i]], Verts[Result[i + 1]], Verts[Result[i + 2]], N);
+
+		double Length = sqrt(N[0] * N[0] + N[1] * N[1] + N[2] * N[2]);
+		if (Length == 0.0) continue;
+
+		// Planes are weighted by area of triangle, which is a half of cross product length
+		double A = N[0] / Length, B = N[1] / Length, C = N[2] / Length;
+		double D = -(A * Verts[Result[i]].X + B * Verts[Result[i]].Y + C * Verts[Result[i]].Z);
+		double W = Length * 0.5;
+		Quadric Q = { A * A * W, A * B * W, A * C * W, A * D * W, B * B * W, B * C * W, B * D * W, C * C * W, C * D * W, D * D * W, W };
+
+		for (int k = 0; k < 3; k++) QuadricAdd(Quadrics[Result[i + k]], Q);
+	}
+
+	double MaxError = 0.0;
+	std::vector<uint64_t> Offsets(VertexCount + 1);
+	std::vector<uint32_t> Adjacency;
+	std::vector<Collapse> Collapses;
+	std::vector<uint32_t> Remap(VertexCount);
+	std::vector<uint8_t> Touched(VertexCount);
+
+	for (int Pass = 0; Pass < SIMPLIFY_MAX_PASSES && Result.size() > TargetCount; Pass++)
+	{
+		// Triangles of every vertex
+		std::fill(Offsets.begin(), Offsets.end(), 0);
+		for (uint32_t Index : Result) Offsets[Index + 1]++;
+		for (uint32_t v = 0; v < VertexCount; v++) Offsets[v + 1] += Offsets[v];
+
+		Adjacency.resize(Result.size());
+		std::vector<uint64_t> Fill(Offsets.begin(), Offsets.end() - 1);
+		for (uint64_t i = 0; i < Result.size(); i++) Adjacency[Fill[Result[i]]++] = (uint32_t)(i / 3);
+
+		// The cheapest collapse of every vertex into one of its neighbours
+		Collapses.clear();
+
+		for (uint32_t v = 0; v < VertexCount; v++)
+		{
+			if (Locked[v]) continue;
+
+			Collapse Best = { v, v, INFINITY };
+
+			for (uint64_t j = Offsets[v]; j < Offsets[v + 1]; j++)
+			{
+				const uint32_t* Triangle = &Result[Adjacency[j] * 3];
+
+				for (int k = 0; k < 3; k++)
+				{
+					if (Triangle[k] == v) continue;
+
+					double Cost = QuadricError(Quadrics[v], Verts[Triangle[k]]);
+					if (Cost < Best.Cost) Best = { v, Triangle[k], Cost };
+				}
+			}
+
+			if (Best.To != v) Collapses.push_back(Best);
+		}
+
+		std::sort(Collapses.begin(), Collapses.end(), [](const Collapse& A, const Collapse& B) { return A.Cost < B.Cost; });
+
+		for (uint32_t v = 0; v < VertexCount; v++) Remap[v] = v;
+		std::fill(Touched.begin(), Touched.end(), 0);
+
+		uint64_t TriangleCount = Result.size() / 3;
+		uint64_t Applied = 0;
+
+		for (const Collapse& C : Collapses)
+		{
+			if (TriangleCount * 3 <= TargetCount) break;
+			if (Touched[C.From] || Touched[C.To]) continue;
+
+			// Triangles around moved vertex must not flip, triangles of collapsed edge disappear
+			bool Flips = false;
+			uint64_t Removed = 0;
+
+			for (uint64_t j = Offsets[C.From]; j < Offsets[C.From + 1] && !Flips; j++)
+			{
+				const uint32_t* Triangle = &Result[Adjacency[j] * 3];
+
+				if (Triangle[0] == C.To || Triangle[1] == C.To || Triangle[2] == C.To)
+				{
+					Removed++;
+					continue;
+				}
+
+				Vertex Moved[3] = { Verts[Triangle[0]], Verts[Triangle[1]], Verts[Triangle[2]] };
+				double Before[3], After[3];
+				TriangleNormal(Moved[0], Moved[1], Moved[2], Before);
+
+				for (int k = 0; k < 3; k++) if (Triangle[k] == C.From) Moved[k] = Verts[C.To];
+				TriangleNormal(Moved[0], Moved[1], Moved[2], After);
+
+				Flips = Before[0] * After[0] + Before[1] * After[1] + Before[2] * After[2] <= 0.0;
+			}
+
+			if (Flips) continue;
+
+			// Neighbours are not moved in the same pass, so checked triangles stay valid
+			for (uint64_t j = Offsets[C.From]; j < Offsets[C.From + 1]; j++)
+			{
+				const uint32_t* Triangle = &Result[Adjacency[j] * 3];
+				for (int k = 0; k < 3; k++) Touched[Triangle[k]] = 1;
+			}
+
+			Remap[C.From] = C.To;
+			QuadricAdd(Quadrics[C.To], Quadrics[C.From]);
+			MaxError = std::max(MaxError, C.Cost / std::max(Quadrics[C.From].Weight, 1e-30));
+			TriangleCount -= Removed;
+			Applied++;
+		}
+
+		if (Applied == 0) break;
+
+		uint64_t Count = 0;
+
+		for (uint64_t i = 0; i < Result.size(); i += 3)
+		{
+			uint32_t A = Remap[Result[i]], B = Remap[Result[i + 1]], C = Remap[Result[i + 2]];
+			if (A == B || B == C || A == C) continue;
+
+			Result[Count++] = A;
+			Result[Count++] = B;
+			Result[Count++] = C;
+		}
+
+		Result.resize(Count);
+	}
+
+	return (float)sqrt(MaxError);
+}
+
+/*
+* Generates Count levels of detail, every level has a half of triangles of previous one.
+* Errors of levels are not decreasing, error of level 0 is 0.
+*/
+void GenerateLods(const std::vector<Vertex>& Verts, const std::vector<uint32_t>& Inds, int Count,
+                  std::vector<std::vector<uint32_t>>& Lods, std::vector<float>& Errors)
+{
+	Lods.clear();
+	Errors.assign(1, 0.0f);
+
+	const std::vector<uint32_t>* Previous = &Inds;
+
+	for (int Level = 1; Level <= Count; Level++)
+	{
+		std::vector<uint32_t> Lod;
+		uint64_t Target = Previous->size() / 6 * 3;
+		float Error = SimplifyMesh(Verts, *Previous, Target, Lod);
+
+		// Level which could not be simplified more is not worth storing
+		if (Lod.size() >= Previous->size()) break;
+
+		Errors.push_back(std::max(Error, Errors.back()));
+		Lods.push_back(std::move(Lod));
+		Previous = &Lods.back();
+	}
+}
+
+void RemapIndices(std::vector<uint32_t>& Inds, const std::vector<uint32_t>& Remap)
+{
+	for (uint32_t& Index : Inds) Index = Remap[Index];
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "util.h"
+#include "../library/cmf.h"
+
+struct MeshletData
+{
+	std::vector<CMF_Meshlet> Meshlets;
+	std::vector<CMF_MeshletBounds> Bounds;
+	std::vector<uint32_t> Vertices;
+	std::vector<uint8_t> Triangles;
+};
+
+// Bounding sphere of meshlet vertices and cone of its triangle normals
+CMF_MeshletBounds ComputeMeshletBounds(const CMF_Meshlet& Meshlet, const MeshletData& Data, const std::vector<Vertex>& Verts)
+{
+	CMF_MeshletBounds Bounds;
+	const uint32_t* Indices = &Data.Vertices[Meshlet.vertex_offset];
+	const uint8_t* Triangles = &Data.Triangles[Meshlet.triangle_offset];
+
+	float Min[3] = { INFINITY, INFINITY, INFINITY };
+	float Max[3] = { -INFINITY, -INFINITY, -INFINITY };
+
+	for (uint32_t i = 0; i < Meshlet.vertex_count; i++)
+	{
+		const Vertex& Vert = Verts[Indices[i]];
+		Min[0] = std::min(Min[0], Vert.X); Max[0] = std::max(Max[0], Vert.X);
+		Min[1] = std::min(Min[1], Vert.Y); Max[1] = std::max(Max[1], Vert.Y);
+		Min[2] = std::min(Min[2], Vert.Z); Max[2] = std::max(Max[2], Vert.Z);
+	}
+
+	float Radius = 0.0f;
+
+	for (int k = 0; k < 3; k++) Bounds.center[k] = (Min[k] + Max[k]) * 0.5f;
+
+	for (uint32_t i = 0; i < Meshlet.vertex_count; i++)
+	{
+		const Vertex& Vert = Verts[Indices[i]];
+		float D[3] = { Vert.X - Bounds.center[0], Vert.Y - Bounds.center[1], Vert.Z - Bounds.center[2] };
+		Radius = std::max(Radius, sqrtf(D[0] * D[0] + D[1] * D[1] + D[2] * D[2]));
+	}
+
+	Bounds.radius = Radius;
+
+	std::vector<float> Normals;
+	float Axis[3] = { 0.0f, 0.0f, 0.0f };
+
+	for (uint32_t t = 0; t < Meshlet.triangle_count; t++)
+	{
+		const Vertex& A = Verts[Indices[Triangles[t * 3 + 0]]];
+		const Vertex& B = Verts[Indices[Triangles[t * 3 + 1]]];
+		const Vertex& C = Verts[Indices[Triangles[t * 3 + 2]]];
+
+		float E1[3] = { B.X - A.X, B.Y - A.Y, B.Z - A.Z };
+		float E2[3] = { C.X - A.X, C.Y - A.Y, C.Z - A.Z };
+		float N[3] = { E1[1] * E2[2] - E1[2] * E2[1], E1[2] * E2[0] - E1[0] * E2[2], E1[0] * E2[1] - E1[1] * E2[0] };
+		float Length = sqrtf(N[0] * N[0] + N[1] * N[1] + N[2] * N[2]);
+
+		// Degenerate triangles are never rasterized, so they do not limit the cone
+		if (Length == 0.0f) continue;
+
+		for (int k = 0; k < 3; k++)
+		{
+			Normals.push_back(N[k] / Length);
+			Axis[k] += N[k] / Length;
+		}
+	}
+
+	float AxisLength = sqrtf(Axis[0] * Axis[0] + Axis[1] * Axis[1] + Axis[2] * Axis[2]);
+	float MinDot = 1.0f;
+
+	for (int k = 0; k < 3; k++) Bounds.cone_axis[k] = AxisLength > 0.0f ? Axis[k] / AxisLength : 0.0f;
+
+	for (size_t i = 0; i < Normals.size(); i += 3)
+	{
+		float Dot = Normals[i] * Bounds.cone_axis[0] + Normals[i + 1] * Bounds.cone_axis[1] + Normals[i + 2] * Bounds.cone_axis[2];
+		MinDot = std::min(MinDot, Dot);
+	}
+
+	// Cone of normals is widened by 90 degrees into cone of backfacing view directions, its cosine becomes sine
+	Bounds.cone_cutoff = AxisLength == 0.0f || MinDot <= 0.1f ? 1.0f : sqrtf(1.0f - MinDot * MinDot);
+	return Bounds;
+}
+
+/*
+* Splits indexed triangles into meshlets in order of indices, so indices should be optimized for vertex cache
+* before, then neighbouring triangles share meshlet. Meshlet is closed when next triangle does not fit in limits.
+*/
+void BuildMeshlets(const std::vector<uint32_t>& Inds, const std::vector<Vertex>& Verts, MeshletData& Data)
+{
+	// Local index of every vertex in current meshlet
+	std::vector<uint8_t> Local(Verts.size(), 0xFF);
+	CMF_Meshlet Meshlet = {};
+
+	Data.Meshlets.clear();
+	Data.Bounds.clear();
+	Data.Vertices.clear();
+	Data.Triangles.clear();
+
+	auto Finish = [&]()
+	{
+		if (Meshlet.triangle_count == 0) return;
+
+		for (uint32_t i = 0; i < Meshlet.vertex_count; i++) Local[Data.Vertices[Meshlet.vertex_offset + i]] = 0xFF;
+
+		Data.Meshlets.push_back(Meshlet);
+		Data.Bounds.push_back(ComputeMeshletBounds(Meshlet, Data, Verts));
+
+		Meshlet = {};
+		Meshlet.vertex_offset = (uint32_t)Data.Vertices.size();
+		Meshlet.triangle_offset = (uint32_t)Data.Triangles.size();
+	};
+
+	for (uint64_t t = 0; t < Inds.size() / 3; t++)
+	{
+		const uint32_t* Triangle = &Inds[t * 3];
+		uint32_t NewVertices = 0;
+
+		for (int k = 0; k < 3; k++)
+		{
+			bool Repeated = (k > 0 && Triangle[k] == Triangle[0]) || (k > 1 && Triangle[k] == Triangle[1]);
+			if (Local[Triangle[k]] == 0xFF && !Repeated) NewVertices++;
+		}
+
+		if (Meshlet.vertex_count + NewVertices > CMF_MESHLET_MAX_VERTICES || Meshlet.triangle_count + 1 > CMF_MESHLET_MAX_TRIANGLES)
+		{
+			Finish();
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			if (Local[Triangle[k]] == 0xFF)
+			{
+				Local[Triangle[k]] = (uint8_t)Meshlet.vertex_count++;
+				Data.Vertices.push_back(Triangle[k]);
+			}
+
+			Data.Triangles.push_back(Local[Triangle[k]]);
+		}
+
+		Meshlet.triangle_count++;
+	}
+
+	Finish();
+}
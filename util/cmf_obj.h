@@ -0,0 +1,393 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <vector>
+#include "util.h"
+#include "cmf_index.h"
+#include "cmf_batch.h"
+#include "../library/cmf.h"
+
+// Ranges of lines are not smaller than this, so small files are parsed on one thread
+#define OBJ_MIN_RANGE_SIZE (1024 * 1024)
+
+// Corner of triangle, indices of position, texcoord and normal, INDEX_EMPTY for missing ones
+struct ObjCorner
+{
+	uint32_t V, T, N;
+};
+
+// Counts of elements in range of lines, their prefix sums are offsets of range in arrays
+struct ObjCounts
+{
+	uint64_t Positions = 0;
+	uint64_t Texcoords = 0;
+	uint64_t Normals = 0;
+	uint64_t Corners = 0;
+};
+
+static const double ObjPowers[23] =
+{
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline const char* ObjSkipSpaces(const char* P, const char* End)
+{
+	while (P < End && (*P == ' ' || *P == '\t')) P++;
+	return P;
+}
+
+static inline const char* ObjSkipToken(const char* P, const char* End)
+{
+	while (P < End && *P != ' ' && *P != '\t') P++;
+	return P;
+}
+
+/*
+* Parses float of line without locale and terminating zero. Mantissa up to 2^53 with
+* exponent up to 22 is exact with one multiplication or division of doubles, so result
+* is the same as of strtod, other numbers (long mantissas, inf, nan) fall back to strtod.
+*/
+static const char* ObjParseFloat(const char* P, const char* End, float& Value)
+{
+	const char* Begin = P;
+	bool Negative = false;
+
+	if (P < End && (*P == '-' || *P == '+')) Negative = *P++ == '-';
+
+	uint64_t Mantissa = 0;
+	int Exponent = 0;
+	int Digits = 0;
+	bool Exact = true;
+
+	for (; P < End && *P >= '0' && *P <= '9'; P++, Digits++)
+	{
+		if (Mantissa < (1ull << 53)) Mantissa = Mantissa * 10 + (*P - '0');
+		else { Exponent++; Exact = false; }
+	}
+
+	if (P < End && *P == '.')
+	{
+		for (P++; P < End && *P >= '0' && *P <= '9'; P++, Digits++)
+		{
+			if (Mantissa < (1ull << 53)) { Mantissa = Mantissa * 10 + (*P - '0'); Exponent--; }
+			else Exact = false;
+		}
+	}
+
+	if (Digits > 0 && P < End && (*P == 'e' || *P == 'E'))
+	{
+		const char* Mark = P++;
+		bool NegativeExponent = false;
+		int Power = 0;
+
+		if (P < End && (*P == '-' || *P == '+')) NegativeExponent = *P++ == '-';
+		if (P == End || *P < '0' || *P > '9') P = Mark;
+
+		for (; P < End && *P >= '0' && *P <= '9'; P++)
+		{
+			if (Power < 10000) Power = Power * 10 + (*P - '0');
+		}
+
+		Exponent += NegativeExponent ? -Power : Power;
+	}
+
+	if (Digits > 0 && Exact && Mantissa <= (1ull << 53) && Exponent >= -22 && Exponent <= 22)
+	{
+		double Result = (double)Mantissa;
+		Result = Exponent < 0 ? Result / ObjPowers[-Exponent] : Result * ObjPowers[Exponent];
+		Value = (float)(Negative ? -Result : Result);
+		return P;
+	}
+
+	// Mapping has no terminating zero, so token is copied for strtod
+	char Token[64];
+	const char* TokenEnd = ObjSkipToken(Begin, End);
+	size_t Length = TokenEnd - Begin;
+
+	if (Length == 0 || Length >= sizeof(Token)) return nullptr;
+
+	memcpy(Token, Begin, Length);
+	Token[Length] = 0;
+
+	char* Parsed;
+	Value = (float)strtod(Token, &Parsed);
+
+	return Parsed == Token ? nullptr : Begin + (Parsed - Token);
+}
+
+// Parses index of face corner, positive indices count from 1, negative ones count back from Count
+static const char* ObjParseIndex(const char* P, const char* End, uint64_t Count, uint32_t& Index)
+{
+	bool Negative = P < End && *P == '-';
+	if (Negative) P++;
+
+	if (P == End || *P < '0' || *P > '9') return nullptr;
+
+	uint64_t Value = 0;
+	for (; P < End && *P >= '0' && *P <= '9'; P++)
+	{
+		Value = Value * 10 + (*P - '0');
+		if (Value > 0xFFFFFFFF) return nullptr;
+	}
+
+	if (Value == 0 || (Negative && Value > Count)) return nullptr;
+
+	Index = (uint32_t)(Negative ? Count - Value : Value - 1);
+	return P;
+}
+
+// Parses corner "v", "v/t", "v//n" or "v/t/n", Counts are elements defined before the face
+static const char* ObjParseCorner(const char* P, const char* End, const ObjCounts& Counts, ObjCorner& Corner)
+{
+	Corner.T = INDEX_EMPTY;
+	Corner.N = INDEX_EMPTY;
+
+	P = ObjParseIndex(P, End, Counts.Positions, Corner.V);
+	if (P == nullptr || P == End || *P != '/') return P;
+
+	P++;
+
+	if (P < End && *P != '/')
+	{
+		P = ObjParseIndex(P, End, Counts.Texcoords, Corner.T);
+		if (P == nullptr || P == End || *P != '/') return P;
+	}
+
+	return ObjParseIndex(P + 1, End, Counts.Normals, Corner.N);
+}
+
+// Type of line: 1 for position, 2 for texcoord, 3 for normal, 4 for face, 0 for everything else
+static inline int ObjLineType(const char*& P, const char* End)
+{
+	P = ObjSkipSpaces(P, End);
+	if (End - P < 2) return 0;
+
+	if (P[0] == 'f' && (P[1] == ' ' || P[1] == '\t')) { P += 2; return 4; }
+	if (P[0] != 'v') return 0;
+
+	if (P[1] == ' ' || P[1] == '\t') { P += 2; return 1; }
+	if (End - P < 3 || (P[2] != ' ' && P[2] != '\t')) return 0;
+
+	if (P[1] == 't') { P += 3; return 2; }
+	if (P[1] == 'n') { P += 3; return 3; }
+
+	return 0;
+}
+
+// Calls Line for every line of [Begin; End) without line feed and carriage return
+template <typename Function>
+static void ObjForEachLine(const char* Begin, const char* End, Function Line)
+{
+	while (Begin < End)
+	{
+		const char* LineEnd = (const char*)memchr(Begin, '\n', End - Begin);
+		if (LineEnd == nullptr) LineEnd = End;
+
+		const char* Next = LineEnd + (LineEnd < End);
+		if (LineEnd > Begin && LineEnd[-1] == '\r') LineEnd--;
+
+		Line(Begin, LineEnd);
+		Begin = Next;
+	}
+}
+
+// The first pass only classifies lines and counts tokens of faces, polygons become fans of triangles
+static void ObjCount(const char* Begin, const char* End, ObjCounts& Counts)
+{
+	ObjForEachLine(Begin, End, [&](const char* P, const char* LineEnd)
+	{
+		switch (ObjLineType(P, LineEnd))
+		{
+		case 1: Counts.Positions++; break;
+		case 2: Counts.Texcoords++; break;
+		case 3: Counts.Normals++;   break;
+		case 4:
+		{
+			uint64_t Tokens = 0;
+
+			for (P = ObjSkipSpaces(P, LineEnd); P < LineEnd; P = ObjSkipSpaces(ObjSkipToken(P, LineEnd), LineEnd)) Tokens++;
+			if (Tokens >= 3) Counts.Corners += (Tokens - 2) * 3;
+			break;
+		}
+		}
+	});
+}
+
+// The second pass parses range into arrays at offsets of range, returns false on malformed line
+static bool ObjParse(const char* Begin, const char* End, ObjCounts Offsets, float* Positions, float* Texcoords, float* Normals, ObjCorner* Corners)
+{
+	bool Result = true;
+
+	ObjForEachLine(Begin, End, [&](const char* P, const char* LineEnd)
+	{
+		if (!Result) return;
+
+		int Type = ObjLineType(P, LineEnd);
+		if (Type == 0) return;
+
+		if (Type == 4)
+		{
+			ObjCorner First, Previous, Corner;
+			uint64_t Count = 0;
+
+			for (P = ObjSkipSpaces(P, LineEnd); P < LineEnd && Result; P = ObjSkipSpaces(P, LineEnd), Count++)
+			{
+				const char* Parsed = ObjParseCorner(P, LineEnd, Offsets, Corner);
+				Result = Parsed != nullptr && (Parsed == LineEnd || *Parsed == ' ' || *Parsed == '\t');
+				P = ObjSkipToken(P, LineEnd);
+
+				if (Count == 0) First = Corner;
+				if (Count >= 2)
+				{
+					Corners[Offsets.Corners++] = First;
+					Corners[Offsets.Corners++] = Previous;
+					Corners[Offsets.Corners++] = Corner;
+				}
+
+				Previous = Corner;
+			}
+
+			return;
+		}
+
+		const uint32_t Components[4] = { 0, 3, 2, 3 };
+		float Values[3] = { 0.0f, 0.0f, 0.0f };
+
+		for (uint32_t i = 0; i < Components[Type] && Result; i++)
+		{
+			P = ObjSkipSpaces(P, LineEnd);
+
+			// Texture coordinate v is optional
+			if (Type == 2 && i == 1 && P == LineEnd) break;
+
+			P = ObjParseFloat(P, LineEnd, Values[i]);
+			Result = P != nullptr;
+		}
+
+		switch (Type)
+		{
+		case 1: memcpy(Positions + Offsets.Positions++ * 3, Values, 3 * sizeof(float)); break;
+		case 2: memcpy(Texcoords + Offsets.Texcoords++ * 2, Values, 2 * sizeof(float)); break;
+		case 3: memcpy(Normals + Offsets.Normals++ * 3, Values, 3 * sizeof(float));     break;
+		}
+	});
+
+	return Result;
+}
+
+/*
+* Welds corners with the same position, texcoord and normal into vertices in order of their first use.
+* Vertices of one position are chained, so no hash table is needed and chains are short.
+*/
+static bool ObjWeld(const std::vector<ObjCorner>& Corners, const std::vector<float>& Positions, const std::vector<float>& Texcoords,
+                    const std::vector<float>& Normals, std::vector<Vertex>& Vertices, std::vector<uint32_t>& Indices)
+{
+	uint64_t PositionCount = Positions.size() / 3;
+	uint64_t TexcoordCount = Texcoords.size() / 2;
+	uint64_t NormalCount = Normals.size() / 3;
+
+	std::vector<uint32_t> Heads(PositionCount, INDEX_EMPTY);
+	std::vector<uint32_t> Next;
+	std::vector<ObjCorner> Keys;
+
+	Indices.resize(Corners.size());
+
+	for (uint64_t i = 0; i < Corners.size(); i++)
+	{
+		const ObjCorner& Corner = Corners[i];
+
+		if (Corner.V >= PositionCount ||
+		    (Corner.T != INDEX_EMPTY && Corner.T >= TexcoordCount) ||
+		    (Corner.N != INDEX_EMPTY && Corner.N >= NormalCount))
+		{
+			return false;
+		}
+
+		uint32_t Unique = Heads[Corner.V];
+		while (Unique != INDEX_EMPTY && (Keys[Unique].T != Corner.T || Keys[Unique].N != Corner.N)) Unique = Next[Unique];
+
+		if (Unique == INDEX_EMPTY)
+		{
+			if (Vertices.size() == INDEX_EMPTY) return false;
+
+			Unique = (uint32_t)Vertices.size();
+			Next.push_back(Heads[Corner.V]);
+			Keys.push_back(Corner);
+			Heads[Corner.V] = Unique;
+
+			Vertex Vert = {};
+			memcpy(&Vert.X, &Positions[Corner.V * 3ull], 3 * sizeof(float));
+			if (Corner.T != INDEX_EMPTY) memcpy(&Vert.U, &Texcoords[Corner.T * 2ull], 2 * sizeof(float));
+			if (Corner.N != INDEX_EMPTY) memcpy(&Vert.NX, &Normals[Corner.N * 3ull], 3 * sizeof(float));
+			Vertices.push_back(Vert);
+		}
+
+		Indices[i] = Unique;
+	}
+
+	return true;
+}
+
+/*
+* Loads Wavefront OBJ into welded vertices and indices of triangles. File is mapped and split
+* into ranges of lines, which are counted and then parsed on Threads threads (0 for all hardware threads).
+* Only positions, texture coordinates, normals and faces are read, polygons are triangulated as fans.
+*/
+bool LoadOBJ(const char* FileName, std::vector<Vertex>& Vertices, std::vector<uint32_t>& Indices, uint32_t Threads = 0)
+{
+	struct CMF_Mapping Mapping;
+	if (CMF_MapFile(FileName, &Mapping) != 0) return false;
+
+	const char* Data = (const char*)Mapping.address;
+	uint64_t Size = Mapping.length;
+
+	if (Threads == 0) Threads = std::max(1u, std::thread::hardware_concurrency());
+
+	// More ranges than threads, so threads steal ranges of lines with many faces
+	uint64_t RangeCount = std::max<uint64_t>(1, std::min<uint64_t>(Size / OBJ_MIN_RANGE_SIZE, Threads * 4ull));
+	std::vector<const char*> Bounds(RangeCount + 1);
+
+	Bounds[0] = Data;
+	Bounds[RangeCount] = Data + Size;
+
+	for (uint64_t i = 1; i < RangeCount; i++)
+	{
+		const char* P = std::max(Data + Size * i / RangeCount, Bounds[i - 1]);
+		const char* LineFeed = (const char*)memchr(P, '\n', Data + Size - P);
+		Bounds[i] = LineFeed != nullptr ? LineFeed + 1 : Data + Size;
+	}
+
+	std::vector<ObjCounts> Offsets(RangeCount + 1);
+	RunJobs(RangeCount, Threads, [&](uint64_t Range) { ObjCount(Bounds[Range], Bounds[Range + 1], Offsets[Range + 1]); });
+
+	for (uint64_t i = 1; i <= RangeCount; i++)
+	{
+		Offsets[i].Positions += Offsets[i - 1].Positions;
+		Offsets[i].Texcoords += Offsets[i - 1].Texcoords;
+		Offsets[i].Normals   += Offsets[i - 1].Normals;
+		Offsets[i].Corners   += Offsets[i - 1].Corners;
+	}
+
+	const ObjCounts& Total = Offsets[RangeCount];
+	std::vector<float> Positions(Total.Positions * 3);
+	std::vector<float> Texcoords(Total.Texcoords * 2);
+	std::vector<float> Normals(Total.Normals * 3);
+	std::vector<ObjCorner> Corners(Total.Corners);
+	std::atomic<bool> Result(true);
+
+	RunJobs(RangeCount, Threads, [&](uint64_t Range)
+	{
+		if (!ObjParse(Bounds[Range], Bounds[Range + 1], Offsets[Range], Positions.data(), Texcoords.data(), Normals.data(), Corners.data())) Result = false;
+	});
+
+	CMF_UnmapFile(&Mapping);
+
+	Vertices.clear();
+	Indices.clear();
+
+	return Result && ObjWeld(Corners, Positions, Texcoords, Normals, Vertices, Indices);
+}
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "util.h"
+#include "cmf_index.h"
+
+#define VERTEX_CACHE_SIZE 32
+#define SIMULATED_CACHE_SIZE 16
+
+// Vertex score of Forsyth's "Linear-Speed Vertex Cache Optimisation"
+float VertexCacheScore(int CachePosition, uint32_t Remaining)
+{
+	if (Remaining == 0) return -1.0f;
+
+	float Score = 0.0f;
+
+	if (CachePosition >= 0)
+	{
+		// Vertices of the last triangle get fixed score, so the next one does not reuse them too eagerly
+		if (CachePosition < 3) Score = 0.75f;
+		else Score = powf(1.0f - (CachePosition - 3) / float(VERTEX_CACHE_SIZE - 3), 1.5f);
+	}
+
+	// Vertices with few remaining triangles are finished first
+	return Score + 2.0f / sqrtf((float)Remaining);
+}
+
+/*
+* Average count of vertex shader invocations per triangle with FIFO cache of the GPU,
+* 0.5 is ideal for big meshes, 3 means that cache is not used at all.
+*/
+float AverageCacheMissRatio(const std::vector<uint32_t>& Inds, uint32_t VertexCount)
+{
+	if (Inds.size() < 3) return 0.0f;
+
+	std::vector<uint64_t> Timestamps(VertexCount, 0);
+	uint64_t Time = SIMULATED_CACHE_SIZE + 1;
+	uint64_t Misses = 0;
+
+	for (uint32_t Index : Inds)
+	{
+		if (Time - Timestamps[Index] > SIMULATED_CACHE_SIZE)
+		{
+			Timestamps[Index] = Time++;
+			Misses++;
+		}
+	}
+
+	return float(Misses) / (Inds.size() / 3);
+}
+
+/*
+* Reorders triangles of indexed mesh for post-transform vertex cache.
+* Greedily emits triangle with best sum of vertex scores among triangles
+* of vertices in simulated LRU cache.
+*/
+void OptimizeVertexCache(std::vector<uint32_t>& Inds, uint32_t VertexCount)
+{
+	uint64_t TriangleCount = Inds.size() / 3;
+	if (TriangleCount == 0) return;
+
+	// Triangles of every vertex, not emitted ones are kept at beginning of vertex range
+	std::vector<uint32_t> Remaining(VertexCount, 0);
+	std::vector<uint64_t> Offsets(VertexCount + 1, 0);
+	std::vector<uint32_t> Adjacency(TriangleCount * 3);
+
+	for (uint64_t i = 0; i < TriangleCount * 3; i++) Remaining[Inds[i]]++;
+	for (uint32_t v = 0; v < VertexCount; v++) Offsets[v + 1] = Offsets[v] + Remaining[v];
+
+	std::vector<uint64_t> Fill(Offsets.begin(), Offsets.end() - 1);
+	for (uint64_t i = 0; i < TriangleCount * 3; i++) Adjacency[Fill[Inds[i]]++] = (uint32_t)(i / 3);
+
+	std::vector<int> CachePositions(VertexCount, -1);
+	std::vector<float> Scores(VertexCount);
+	std::vector<float> TriangleScores(TriangleCount, 0.0f);
+	std::vector<bool> Emitted(TriangleCount, false);
+
+	for (uint32_t v = 0; v < VertexCount; v++) Scores[v] = VertexCacheScore(-1, Remaining[v]);
+	for (uint64_t i = 0; i < TriangleCount * 3; i++) TriangleScores[i / 3] += Scores[Inds[i]];
+
+	std::vector<uint32_t> Result;
+	Result.reserve(TriangleCount * 3);
+
+	std::vector<uint32_t> Cache, NewCache;
+	Cache.reserve(VertexCount + 3);
+	NewCache.reserve(VertexCount + 3);
+
+	int64_t Best = std::max_element(TriangleScores.begin(), TriangleScores.end()) - TriangleScores.begin();
+	uint64_t Cursor = 0;
+
+	while (Result.size() < TriangleCount * 3)
+	{
+		if (Best < 0)
+		{
+			// Cache has no vertices with remaining triangles, next triangle in input order starts new strip
+			while (Emitted[Cursor]) Cursor++;
+			Best = Cursor;
+		}
+
+		const uint32_t* Triangle = &Inds[Best * 3];
+		Emitted[Best] = true;
+
+		NewCache.clear();
+
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t Vert = Triangle[k];
+			Result.push_back(Vert);
+			NewCache.push_back(Vert);
+
+			// Remove triangle from remaining triangles of vertex
+			uint32_t* Begin = &Adjacency[Offsets[Vert]];
+			uint32_t* End = Begin + Remaining[Vert];
+			std::swap(*std::find(Begin, End, (uint32_t)Best), End[-1]);
+			Remaining[Vert]--;
+		}
+
+		for (uint32_t Vert : Cache)
+		{
+			if (Vert != Triangle[0] && Vert != Triangle[1] && Vert != Triangle[2]) NewCache.push_back(Vert);
+		}
+
+		// Vertices out of cache size are evicted, their scores are updated too
+		for (uint64_t i = 0; i < NewCache.size(); i++)
+		{
+			uint32_t Vert = NewCache[i];
+			CachePositions[Vert] = i < VERTEX_CACHE_SIZE ? (int)i : -1;
+
+			float Score = VertexCacheScore(CachePositions[Vert], Remaining[Vert]);
+			float Delta = Score - Scores[Vert];
+			Scores[Vert] = Score;
+
+			for (uint32_t j = 0; j < Remaining[Vert]; j++) TriangleScores[Adjacency[Offsets[Vert] + j]] += Delta;
+		}
+
+		if (NewCache.size() > VERTEX_CACHE_SIZE) NewCache.resize(VERTEX_CACHE_SIZE);
+		std::swap(Cache, NewCache);
+
+		Best = -1;
+		float BestScore = -1.0f;
+
+		for (uint32_t Vert : Cache)
+		{
+			for (uint32_t j = 0; j < Remaining[Vert]; j++)
+			{
+				uint32_t Tri = Adjacency[Offsets[Vert] + j];
+
+				if (TriangleScores[Tri] > BestScore)
+				{
+					BestScore = TriangleScores[Tri];
+					Best = Tri;
+				}
+			}
+		}
+	}
+
+	Inds.swap(Result);
+}
+
+/*
+* Reduces overdraw without breaking vertex cache order: triangles are split into clusters
+* at cache flushes (triangle with three missed vertices), then clusters facing outside
+* of the mesh are drawn first, so they occlude the rest.
+*/
+void OptimizeOverdraw(std::vector<uint32_t>& Inds, const std::vector<Vertex>& Verts)
+{
+	uint64_t TriangleCount = Inds.size() / 3;
+	if (TriangleCount == 0) return;
+
+	std::vector<uint64_t> Clusters;
+	std::vector<uint64_t> Timestamps(Verts.size(), 0);
+	uint64_t Time = SIMULATED_CACHE_SIZE + 1;
+
+	for (uint64_t t = 0; t < TriangleCount; t++)
+	{
+		int Misses = 0;
+
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t Index = Inds[t * 3 + k];
+
+			if (Time - Timestamps[Index] > SIMULATED_CACHE_SIZE)
+			{
+				Timestamps[Index] = Time++;
+				Misses++;
+			}
+		}
+
+		if (t == 0 || Misses == 3) Clusters.push_back(t);
+	}
+
+	Clusters.push_back(TriangleCount);
+
+	double Sum[3] = { 0.0, 0.0, 0.0 };
+
+	for (const auto& Vert : Verts)
+	{
+		Sum[0] += Vert.X;
+		Sum[1] += Vert.Y;
+		Sum[2] += Vert.Z;
+	}
+
+	float Center[3] = { float(Sum[0] / Verts.size()), float(Sum[1] / Verts.size()), float(Sum[2] / Verts.size()) };
+
+	// Sort key is a distance from mesh center along average normal of cluster
+	std::vector<float> Keys(Clusters.size() - 1);
+
+	for (uint64_t c = 0; c + 1 < Clusters.size(); c++)
+	{
+		float Centroid[3] = { 0.0f, 0.0f, 0.0f };
+		float Normal[3] = { 0.0f, 0.0f, 0.0f };
+		float Area = 0.0f;
+
+		for (uint64_t t = Clusters[c]; t < Clusters[c + 1]; t++)
+		{
+			const Vertex& A = Verts[Inds[t * 3 + 0]];
+			const Vertex& B = Verts[Inds[t * 3 + 1]];
+			const Vertex& C = Verts[Inds[t * 3 + 2]];
+
+			float E1[3] = { B.X - A.X, B.Y - A.Y, B.Z - A.Z };
+			float E2[3] = { C.X - A.X, C.Y - A.Y, C.Z - A.Z };
+			float N[3] = { E1[1] * E2[2] - E1[2] * E2[1], E1[2] * E2[0] - E1[0] * E2[2], E1[0] * E2[1] - E1[1] * E2[0] };
+			float TriangleArea = sqrtf(N[0] * N[0] + N[1] * N[1] + N[2] * N[2]);
+
+			// Cross product is already weighted by area
+			Normal[0] += N[0]; Normal[1] += N[1]; Normal[2] += N[2];
+			Centroid[0] += (A.X + B.X + C.X) / 3.0f * TriangleArea;
+			Centroid[1] += (A.Y + B.Y + C.Y) / 3.0f * TriangleArea;
+			Centroid[2] += (A.Z + B.Z + C.Z) / 3.0f * TriangleArea;
+			Area += TriangleArea;
+		}
+
+		float Length = sqrtf(Normal[0] * Normal[0] + Normal[1] * Normal[1] + Normal[2] * Normal[2]);
+		if (Area == 0.0f || Length == 0.0f) { Keys[c] = 0.0f; continue; }
+
+		Keys[c] = ((Centroid[0] / Area - Center[0]) * Normal[0] +
+		           (Centroid[1] / Area - Center[1]) * Normal[1] +
+		           (Centroid[2] / Area - Center[2]) * Normal[2]) / Length;
+	}
+
+	std::vector<uint64_t> Order(Keys.size());
+	for (uint64_t c = 0; c < Order.size(); c++) Order[c] = c;
+	std::stable_sort(Order.begin(), Order.end(), [&Keys](uint64_t A, uint64_t B) { return Keys[A] > Keys[B]; });
+
+	std::vector<uint32_t> Result;
+	Result.reserve(Inds.size());
+
+	for (uint64_t c : Order)
+	{
+		Result.insert(Result.end(), Inds.begin() + Clusters[c] * 3, Inds.begin() + Clusters[c + 1] * 3);
+	}
+
+	Inds.swap(Result);
+}
+
+/*
+* Reorders vertices in order of their first use by indices, so vertex fetch reads memory sequentially.
+* Returns new index of every old vertex to remap other index arrays of the same vertices.
+*/
+std::vector<uint32_t> OptimizeVertexFetch(std::vector<uint32_t>& Inds, std::vector<Vertex>& Verts)
+{
+	std::vector<uint32_t> Remap(Verts.size(), INDEX_EMPTY);
+	std::vector<Vertex> Result;
+	Result.reserve(Verts.size());
+
+	for (uint32_t& Index : Inds)
+	{
+		if (Remap[Index] == INDEX_EMPTY)
+		{
+			Remap[Index] = (uint32_t)Result.size();
+			Result.push_back(Verts[Index]);
+		}
+
+		Index = Remap[Index];
+	}
+
+	// Vertices without triangles are kept at the end
+	for (uint64_t v = 0; v < Verts.size(); v++)
+	{
+		if (Remap[v] == INDEX_EMPTY)
+		{
+			Remap[v] = (uint32_t)Result.size();
+			Result.push_back(Verts[v]);
+		}
+	}
+
+	Verts.swap(Result);
+	return Remap;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "util.h"
+#include "../library/cmf.h"
+
+// Min and max corners of positions, written into CMF_TYPE_BOUNDS array
+void ComputeBounds(const std::vector<Vertex>& Verts, float* Bounds)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		Bounds[i] = Verts.empty() ? 0.0f : INFINITY;
+		Bounds[i + 3] = Verts.empty() ? 0.0f : -INFINITY;
+	}
+
+	for (const auto& Vert : Verts)
+	{
+		const float Position[3] = { Vert.X, Vert.Y, Vert.Z };
+
+		for (int i = 0; i < 3; i++)
+		{
+			Bounds[i] = std::min(Bounds[i], Position[i]);
+			Bounds[i + 3] = std::max(Bounds[i + 3], Position[i]);
+		}
+	}
+}
+
+// Rounds float to nearest half, overflow becomes infinity
+uint16_t FloatToHalf(float Value)
+{
+	uint32_t Bits;
+	memcpy(&Bits, &Value, sizeof(Bits));
+
+	uint16_t Sign = (Bits >> 16) & 0x8000;
+	int32_t Exponent = (int32_t)((Bits >> 23) & 0xFF) - 127 + 15;
+	uint32_t Mantissa = Bits & 0x7FFFFF;
+
+	if (((Bits >> 23) & 0xFF) == 0xFF) return Sign | 0x7C00 | (Mantissa ? 0x200 : 0);
+	if (Exponent >= 0x1F) return Sign | 0x7C00;
+
+	if (Exponent <= 0)
+	{
+		// Subnormal half, implicit one is shifted into mantissa
+		if (Exponent < -10) return Sign;
+
+		Mantissa |= 0x800000;
+		uint32_t Shift = 14 - Exponent;
+		uint32_t Half = Mantissa >> Shift;
+		uint32_t Rest = Mantissa & ((1u << Shift) - 1);
+		uint32_t Middle = 1u << (Shift - 1);
+
+		if (Rest > Middle || (Rest == Middle && (Half & 1))) Half++;
+		return Sign | Half;
+	}
+
+	uint32_t Half = ((uint32_t)Exponent << 10) | (Mantissa >> 13);
+	uint32_t Rest = Mantissa & 0x1FFF;
+
+	// Carry of rounding may overflow into exponent, which is still correct
+	if (Rest > 0x1000 || (Rest == 0x1000 && (Half & 1))) Half++;
+	return Sign | Half;
+}
+
+// Projects unit vector onto octahedron and unfolds it into square [-1; 1]
+void EncodeOctahedral(float X, float Y, float Z, float* Out)
+{
+	float Length = fabsf(X) + fabsf(Y) + fabsf(Z);
+	if (Length == 0.0f) { Out[0] = 0.0f; Out[1] = 0.0f; return; }
+
+	X /= Length;
+	Y /= Length;
+
+	if (Z < 0.0f)
+	{
+		float FoldedX = (1.0f - fabsf(Y)) * (X >= 0.0f ? 1.0f : -1.0f);
+		float FoldedY = (1.0f - fabsf(X)) * (Y >= 0.0f ? 1.0f : -1.0f);
+		X = FoldedX;
+		Y = FoldedY;
+	}
+
+	Out[0] = X;
+	Out[1] = Y;
+}
+
+template <typename T>
+T QuantizeNormalized(float Value, float MaxValue)
+{
+	return (T)lrintf(std::min(std::max(Value, -1.0f), 1.0f) * MaxValue);
+}
+
+/*
+* Converts Count vertices of float array of given type into Format, which is one of:
+* USHORT positions normalized against Bounds, HALF texcoords,
+* BYTE or SHORT octahedral normals and tangents. Returns size of output data.
+*/
+uint64_t QuantizeArray(uint32_t Type, uint32_t Format, const float* In, uint64_t Count, const float* Bounds, void* Out)
+{
+	if (Type == CMF_TYPE_POSITION)
+	{
+		uint16_t* Dst = (uint16_t*)Out;
+
+		for (uint64_t i = 0; i < Count * 3; i++)
+		{
+			float Extent = Bounds[i % 3 + 3] - Bounds[i % 3];
+			Dst[i] = Extent > 0.0f ? QuantizeNormalized<uint16_t>((In[i] - Bounds[i % 3]) / Extent, 65535.0f) : 0;
+		}
+
+		return Count * 3 * sizeof(uint16_t);
+	}
+
+	if (Type == CMF_TYPE_TEXCOORD)
+	{
+		uint16_t* Dst = (uint16_t*)Out;
+		for (uint64_t i = 0; i < Count * 2; i++) Dst[i] = FloatToHalf(In[i]);
+		return Count * 2 * sizeof(uint16_t);
+	}
+
+	for (uint64_t i = 0; i < Count; i++)
+	{
+		float Encoded[2];
+		EncodeOctahedral(In[i * 3], In[i * 3 + 1], In[i * 3 + 2], Encoded);
+
+		if (Format == CMF_FORMAT_BYTE)
+		{
+			((int8_t*)Out)[i * 2 + 0] = QuantizeNormalized<int8_t>(Encoded[0], 127.0f);
+			((int8_t*)Out)[i * 2 + 1] = QuantizeNormalized<int8_t>(Encoded[1], 127.0f);
+		}
+		else
+		{
+			((int16_t*)Out)[i * 2 + 0] = QuantizeNormalized<int16_t>(Encoded[0], 32767.0f);
+			((int16_t*)Out)[i * 2 + 1] = QuantizeNormalized<int16_t>(Encoded[1], 32767.0f);
+		}
+	}
+
+	return Count * 2 * CMF_FormatSize(Format);
+}
@@ -1,7 +1,15 @@
+#pragma once
+
 #include <cstdio>
+#include <cstdint>
 #include <iostream>
 #include <iterator>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 struct Vertex
 {
@@ -22,13 +30,61 @@ void PrintProgress(double Percentage)
 	fflush(stdout);
 }
 
+/*
+* Prints progress of work a few times per second from its own thread, so workers only add
+* to atomic counter and never print or compute percents in their loops. Quiet reporter only counts.
+*/
+class ProgressReporter
+{
+public:
+	ProgressReporter(uint64_t Count, bool Quiet = false) : Total(Count), Done(0), Stop(false)
+	{
+		if (Quiet) return;
 
+		Thread = std::thread([this]()
+		{
+			std::unique_lock<std::mutex> Lock(Mutex);
+			int Printed = -1;
 
+			do
+			{
+				double Percentage = Total != 0 ? std::min(1.0, double(Done) / Total) : 1.0;
+				if ((int)(Percentage * 100) != Printed) PrintProgress(Percentage);
+				Printed = (int)(Percentage * 100);
+			} while (!Signal.wait_for(Lock, std::chrono::milliseconds(100), [this]() { return Stop; }));
 
+			if (Printed != 100) PrintProgress(1.0);
+			printf("\n");
+		});
+	}
 
+	void Add(uint64_t Count)
+	{
+		Done += Count;
+	}
 
+	uint64_t GetDone() const
+	{
+		return Done;
+	}
 
+	~ProgressReporter()
+	{
+		if (!Thread.joinable()) return;
 
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+			Stop = true;
+		}
 
-
-
+		Signal.notify_one();
+		Thread.join();
+	}
+private:
+	uint64_t Total;
+	std::atomic<uint64_t> Done;
+	std::mutex Mutex;
+	std::condition_variable Signal;
+	bool Stop;
+	std::thread Thread;
+};